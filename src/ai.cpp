@@ -77,6 +77,7 @@ extern "C" DECLSPEC_EXPORT int WINAPI AIPath(int boardW, int boardH, char board[
             }
         }
     }
+    map.rehash();
     m_tetris::TetrisBlockStatus status(curPiece, curX - 1, curY - 1, curR - 1);
     std::string next(nextPiece);
     m_tetris::TetrisNode const *node = tetris_ai.get(status);
@@ -158,6 +159,7 @@ extern "C" DECLSPEC_EXPORT char *__cdecl TetrisAI(int overfield[], int field[],
             }
         }
     }
+    map.rehash();
     srs_ai.update();
     srs_ai.search_config()->allow_rotate_move = false;
     srs_ai.search_config()->allow_180 = can180spin;
@@ -314,6 +316,7 @@ extern "C" DECLSPEC_EXPORT int __cdecl QQTetrisAI(int boardW, int boardH, int bo
             }
         }
     }
+    map.rehash();
     m_tetris::TetrisBlockStatus status(nextPiece[0], curX, curY, (4 - curR) % 4);
     size_t next_length = std::strlen(nextPiece) - 1;
     if (level < 10)
@@ -432,6 +435,7 @@ extern "C" DECLSPEC_EXPORT int __cdecl C2TetrisAI(c2_param *param)
             }
         }
     }
+    map.rehash();
     c2_ai.search_config()->fast_move_down = true;
     c2_ai.ai_config()->p =
     {
@@ -501,54 +505,21 @@ extern "C" DECLSPEC_EXPORT int __cdecl C2TetrisAI(c2_param *param)
                 break;
 
             case 'z':
-                for (auto wall_kick_node : node->wall_kick_counterclockwise)
+                if (m_tetris::TetrisNode const *wall_kick_node = node->wall_kick_counterclockwise.check_first(map))
                 {
-                    if (wall_kick_node)
-                    {
-                        if (wall_kick_node->check(map))
-                        {
-                            node = wall_kick_node;
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        break;
-                    }
+                    node = wall_kick_node;
                 }
                 break;
             case 'x':
-                for (auto wall_kick_node : node->wall_kick_opposite)
+                if (m_tetris::TetrisNode const *wall_kick_node = node->wall_kick_opposite.check_first(map))
                 {
-                    if (wall_kick_node)
-                    {
-                        if (wall_kick_node->check(map))
-                        {
-                            node = wall_kick_node;
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        break;
-                    }
+                    node = wall_kick_node;
                 }
                 break;
             case 'c':
-                for (auto wall_kick_node : node->wall_kick_clockwise)
+                if (m_tetris::TetrisNode const *wall_kick_node = node->wall_kick_clockwise.check_first(map))
                 {
-                    if (wall_kick_node)
-                    {
-                        if (wall_kick_node->check(map))
-                        {
-                            node = wall_kick_node;
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        break;
-                    }
+                    node = wall_kick_node;
                 }
                 break;
             default:
@@ -20,20 +20,7 @@ namespace ai_ax
     void AI::init(m_tetris::TetrisContext const *context)
     {
         context_ = context;
-        map_danger_data_.resize(context->type_max());
-        for(size_t i = 0; i < context->type_max(); ++i)
-        {
-            TetrisMap map(context->width(), context->height());
-            TetrisNode const *node = context->generate(i);
-            node->attach(map);
-            std::memcpy(map_danger_data_[i].data, &map.row[map.height - 4], sizeof map_danger_data_[i].data);
-            for(int y = 0; y < 3; ++y)
-            {
-                map_danger_data_[i].data[y + 1] |= map_danger_data_[i].data[y];
-            }
-        }
-        col_mask_ = context->full() & ~1;
-        row_mask_ = context->full();
+        feature_.init(context);
     }
 
     std::string AI::ai_name() const
@@ -52,24 +39,9 @@ namespace ai_ax
 
         const int width_m1 = map.width - 1;
         //行列变换
-        int ColTrans = 2 * (map.height - map.roof);
-        int RowTrans = ZZZ_BitCount(row_mask_ ^ map.row[0]) + ZZZ_BitCount(map.roof == map.height ? ~row_mask_ & map.row[map.roof - 1] : map.row[map.roof - 1]);
-        for(int y = 0; y < map.roof; ++y)
-        {
-            if(!map.full(0, y))
-            {
-                ++ColTrans;
-            }
-            if(!map.full(width_m1, y))
-            {
-                ++ColTrans;
-            }
-            ColTrans += ZZZ_BitCount((map.row[y] ^ (map.row[y] << 1)) & col_mask_);
-            if(y != 0)
-            {
-                RowTrans += ZZZ_BitCount(map.row[y - 1] ^ map.row[y]);
-            }
-        }
+        auto trans = feature_.trans(map);
+        int ColTrans = trans.col;
+        int RowTrans = trans.row;
         struct
         {
             //洞数
@@ -214,15 +186,7 @@ namespace ai_ax
 
     size_t AI::map_in_danger_(m_tetris::TetrisMap const &map) const
     {
-        size_t danger = 0;
-        for(size_t i = 0; i < context_->type_max(); ++i)
-        {
-            if(map_danger_data_[i].data[0] & map.row[map.height - 4] || map_danger_data_[i].data[1] & map.row[map.height - 3] || map_danger_data_[i].data[2] & map.row[map.height - 2] || map_danger_data_[i].data[3] & map.row[map.height - 1])
-            {
-                ++danger;
-            }
-        }
-        return danger;
+        return context_->map_danger(map, context_->height() - 4, map.height - 4);
     }
 
 }
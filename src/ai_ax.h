@@ -1,6 +1,7 @@
 ﻿
 
 #include "tetris_core.h"
+#include "tetris_feature.h"
 
 namespace ai_ax
 {
@@ -24,13 +25,8 @@ namespace ai_ax
         Status iterate(Status const **status, size_t status_length) const;
 
     private:
-        struct MapInDangerData
-        {
-            int data[4];
-        };
-        std::vector<MapInDangerData> map_danger_data_;
         m_tetris::TetrisContext const *context_;
         size_t map_in_danger_(m_tetris::TetrisMap const &map) const;
-        int col_mask_, row_mask_;
+        m_tetris::TetrisFeature feature_;
     };
 }
@@ -20,20 +20,7 @@ namespace ai_tag
     void the_ai_games_old::init(m_tetris::TetrisContext const *context)
     {
         context_ = context;
-        map_danger_data_.resize(context->type_max());
-        for(size_t i = 0; i < context->type_max(); ++i)
-        {
-            TetrisMap map(context->width(), context->height());
-            TetrisNode const *node = context->generate(i);
-            node->move_down->attach(map);
-            std::memcpy(map_danger_data_[i].data, &map.row[map.height - 4], sizeof map_danger_data_[i].data);
-            for(int y = 0; y < 3; ++y)
-            {
-                map_danger_data_[i].data[y + 1] |= map_danger_data_[i].data[y];
-            }
-        }
-        col_mask_ = context->full() & ~1;
-        row_mask_ = context->full();
+        feature_.init(context);
     }
 
     std::string the_ai_games_old::ai_name() const
@@ -48,26 +35,9 @@ namespace ai_tag
         double EraseCount = clear;
 
         const int width_m1 = map.width - 1;
-        int ColTrans = 2 * (map.height - map.roof);
-        int RowTrans = map.roof == map.height ? 0 : map.width;
-        for(int y = 0; y < map.roof; ++y)
-        {
-            if(!map.full(0, y))
-            {
-                ++ColTrans;
-            }
-            if(!map.full(width_m1, y))
-            {
-                ++ColTrans;
-            }
-            ColTrans += ZZZ_BitCount((map.row[y] ^ (map.row[y] << 1)) & col_mask_);
-            if(y != 0)
-            {
-                RowTrans += ZZZ_BitCount(map.row[y - 1] ^ map.row[y]);
-            }
-        }
-        RowTrans += ZZZ_BitCount(row_mask_ & ~map.row[0]);
-        RowTrans += ZZZ_BitCount(map.roof == map.height ? row_mask_ & ~map.row[map.roof - 1] : map.row[map.roof - 1]);
+        auto trans = feature_.trans_wall(map);
+        int ColTrans = trans.col;
+        int RowTrans = trans.row;
         struct
         {
             int HoleCount;
@@ -358,14 +328,14 @@ namespace ai_tag
 
     size_t the_ai_games_old::map_in_danger_(m_tetris::TetrisMap const &map, size_t up) const
     {
+        m_tetris::TetrisDangerMask const *mask = context_->danger_mask(context_->height() - 3);
         size_t danger = 0;
         for(size_t i = 0; i < context_->type_max(); ++i)
         {
             size_t check_up = up;
             do
             {
-                size_t height = map.height - check_up;
-                if(map_danger_data_[i].data[0] & map.row[height - 4] || map_danger_data_[i].data[1] & map.row[height - 3] || map_danger_data_[i].data[2] & map.row[height - 2] || map_danger_data_[i].data[3] & map.row[height - 1])
+                if(mask[i].check(map, int(map.height - check_up) - 4))
                 {
                     ++danger;
                     break;
@@ -385,20 +355,7 @@ namespace ai_tag
     {
         context_ = context;
         config_ = config;
-        map_danger_data_.resize(context->type_max());
-        for(size_t i = 0; i < context->type_max(); ++i)
-        {
-            TetrisMap map(context->width(), context->height());
-            TetrisNode const *node = context->generate(i);
-            node->move_down->attach(map);
-            std::memcpy(map_danger_data_[i].data, &map.row[map.height - 4], sizeof map_danger_data_[i].data);
-            for(int y = 0; y < 3; ++y)
-            {
-                map_danger_data_[i].data[y + 1] |= map_danger_data_[i].data[y];
-            }
-        }
-        col_mask_ = context->full() & ~1;
-        row_mask_ = context->full();
+        feature_.init(context);
         const int full = context->full();
     }
 
@@ -411,26 +368,9 @@ namespace ai_tag
     {
         Result result;
         const int width_m1 = map.width - 1;
-        int ColTrans = 2 * (map.height - map.roof);
-        int RowTrans = map.roof == map.height ? 0 : map.width;
-        for(int y = 0; y < map.roof; ++y)
-        {
-            if(!map.full(0, y))
-            {
-                ++ColTrans;
-            }
-            if(!map.full(width_m1, y))
-            {
-                ++ColTrans;
-            }
-            ColTrans += ZZZ_BitCount((map.row[y] ^ (map.row[y] << 1)) & col_mask_);
-            if(y != 0)
-            {
-                RowTrans += ZZZ_BitCount(map.row[y - 1] ^ map.row[y]);
-            }
-        }
-        RowTrans += ZZZ_BitCount(row_mask_ & ~map.row[0]);
-        RowTrans += ZZZ_BitCount(map.roof == map.height ? row_mask_ & ~map.row[map.roof - 1] : map.row[map.roof - 1]);
+        auto trans = feature_.trans_wall(map);
+        int ColTrans = trans.col;
+        int RowTrans = trans.row;
         struct
         {
             int HoleCount;
@@ -662,14 +602,14 @@ namespace ai_tag
 
     size_t the_ai_games::map_in_danger_(m_tetris::TetrisMap const &map, size_t up) const
     {
+        m_tetris::TetrisDangerMask const *mask = context_->danger_mask(context_->height() - 3);
         size_t danger = 0;
         for(size_t i = 0; i < context_->type_max(); ++i)
         {
             size_t check_up = up;
             do
             {
-                size_t height = map.height - check_up;
-                if(map_danger_data_[i].data[0] & map.row[height - 4] || map_danger_data_[i].data[1] & map.row[height - 3] || map_danger_data_[i].data[2] & map.row[height - 2] || map_danger_data_[i].data[3] & map.row[height - 1])
+                if(mask[i].check(map, int(map.height - check_up) - 4))
                 {
                     ++danger;
                     break;
@@ -1,5 +1,6 @@
 
 #include "tetris_core.h"
+#include "tetris_feature.h"
 #include "search_tag.h"
 #include <functional>
 
@@ -31,12 +32,7 @@ namespace ai_tag
 
     private:
         m_tetris::TetrisContext const *context_;
-        int col_mask_, row_mask_;
-        struct MapInDangerData
-        {
-            int data[4];
-        };
-        std::vector<MapInDangerData> map_danger_data_;
+        m_tetris::TetrisFeature feature_;
         size_t map_in_danger_(m_tetris::TetrisMap const &map, size_t up) const;
     };
 
@@ -89,12 +85,7 @@ namespace ai_tag
     private:
         m_tetris::TetrisContext const *context_;
         Config const *config_;
-        int col_mask_, row_mask_;
-        struct MapInDangerData
-        {
-            int data[4];
-        };
-        std::vector<MapInDangerData> map_danger_data_;
+        m_tetris::TetrisFeature feature_;
     public:
         int map_for_tspin_(m_tetris::TetrisMap const &map, int x, int y) const;
         size_t map_in_danger_(m_tetris::TetrisMap const &map, size_t up) const;
@@ -77,20 +77,7 @@ namespace ai_zzz
             }
             std::sort(check_line_1_, check_line_1_end_);
             std::sort(check_line_2_, check_line_2_end_);
-            map_danger_data_.resize(context->type_max());
-            for (size_t i = 0; i < context->type_max(); ++i)
-            {
-                TetrisMap map(context->width(), context->height());
-                TetrisNode const *node = context->generate(i);
-                node->attach(map);
-                std::memcpy(map_danger_data_[i].data, &map.row[map.height - 4], sizeof map_danger_data_[i].data);
-                for (int y = 0; y < 3; ++y)
-                {
-                    map_danger_data_[i].data[y + 1] |= map_danger_data_[i].data[y];
-                }
-            }
-            col_mask_ = context->full() & ~1;
-            row_mask_ = context->full();
+            feature_.init(context);
         }
 
         std::string Attack::ai_name() const
@@ -111,18 +98,9 @@ namespace ai_zzz
             }
 
             const int width_m1 = map.width - 1;
-            int ColTrans = 2 * (map.height - map.roof);
-            int RowTrans = map.roof == map.height ? 0 : map.width;
-            for (int y = 0; y < map.roof; ++y)
-            {
-                ColTrans += !map.full(0, y) + !map.full(width_m1, y) + ZZZ_BitCount((map.row[y] ^ (map.row[y] << 1)) & col_mask_);
-                if (y != 0)
-                {
-                    RowTrans += ZZZ_BitCount(map.row[y - 1] ^ map.row[y]);
-                }
-            }
-            RowTrans += ZZZ_BitCount(row_mask_ & ~map.row[0]);
-            RowTrans += ZZZ_BitCount(map.roof == map.height ? row_mask_ & ~map.row[map.roof - 1] : map.row[map.roof - 1]);
+            auto trans = feature_.trans_wall(map);
+            int ColTrans = trans.col;
+            int RowTrans = trans.row;
             struct
             {
                 int HoleCount;
@@ -333,35 +311,14 @@ namespace ai_zzz
 
         size_t Attack::map_in_danger_(m_tetris::TetrisMap const &map) const
         {
-            size_t danger = 0;
-            for (size_t i = 0; i < context_->type_max(); ++i)
-            {
-                if (map_danger_data_[i].data[0] & map.row[map.height - 4] || map_danger_data_[i].data[1] & map.row[map.height - 3] || map_danger_data_[i].data[2] & map.row[map.height - 2] || map_danger_data_[i].data[3] & map.row[map.height - 1])
-                {
-                    ++danger;
-                }
-            }
-            return danger;
+            return context_->map_danger(map, context_->height() - 4, map.height - 4);
         }
     }
 
     void Dig::init(m_tetris::TetrisContext const *context, Config const *config)
     {
         context_ = context;
-        map_danger_data_.resize(context->type_max());
-        for (size_t i = 0; i < context->type_max(); ++i)
-        {
-            TetrisMap map(context->width(), context->height());
-            TetrisNode const *node = context->generate(i);
-            node->attach(map);
-            std::memcpy(map_danger_data_[i].data, &map.row[map.height - 4], sizeof map_danger_data_[i].data);
-            for (int y = 0; y < 3; ++y)
-            {
-                map_danger_data_[i].data[y + 1] |= map_danger_data_[i].data[y];
-            }
-        }
-        col_mask_ = context->full() & ~1;
-        row_mask_ = context->full();
+        feature_.init(context);
         config_ = config;
     }
 
@@ -373,16 +330,9 @@ namespace ai_zzz
     double Dig::eval(m_tetris::TetrisNode const *node, m_tetris::TetrisMap const &map, m_tetris::TetrisMap const &src_map, size_t clear) const
     {
         const int width_m1 = map.width - 1;
-        size_t ColTrans = 2 * (map.height - map.roof);
-        size_t RowTrans = ZZZ_BitCount(row_mask_ ^ map.row[0]) + ZZZ_BitCount(map.roof == map.height ? ~row_mask_ & map.row[map.roof - 1] : map.row[map.roof - 1]);
-        for (int y = 0; y < map.roof; ++y)
-        {
-            ColTrans += !map.full(0, y) + !map.full(width_m1, y) + ZZZ_BitCount((map.row[y] ^ (map.row[y] << 1)) & col_mask_);
-            if (y != 0)
-            {
-                RowTrans += ZZZ_BitCount(map.row[y - 1] ^ map.row[y]);
-            }
-        }
+        auto trans = feature_.trans(map);
+        size_t ColTrans = trans.col;
+        size_t RowTrans = trans.row;
         struct
         {
             int HoleCount;
@@ -491,15 +441,7 @@ namespace ai_zzz
 
     size_t Dig::map_in_danger_(m_tetris::TetrisMap const &map) const
     {
-        size_t danger = 0;
-        for (size_t i = 0; i < context_->type_max(); ++i)
-        {
-            if (map_danger_data_[i].data[0] & map.row[map.height - 4] || map_danger_data_[i].data[1] & map.row[map.height - 3] || map_danger_data_[i].data[2] & map.row[map.height - 2] || map_danger_data_[i].data[3] & map.row[map.height - 1])
-            {
-                ++danger;
-            }
-        }
-        return danger;
+        return context_->map_danger(map, context_->height() - 4, map.height - 4);
     }
 
     bool TOJ::Status::operator < (Status const &other) const
@@ -509,7 +451,7 @@ namespace ai_zzz
 
     int8_t TOJ::get_safe(m_tetris::TetrisMap const &m) const {
         int safe = 0;
-        while (map_in_danger_(m, safe + 1) == 0)
+        while (safe + 1 < 18 && !context_->map_in_danger(m, 18, 17 - safe))
         {
             ++safe;
         }
@@ -520,20 +462,7 @@ namespace ai_zzz
     {
         context_ = context;
         config_ = config;
-        col_mask_ = context->full() & ~1;
-        row_mask_ = context->full();
-        map_danger_data_.resize(context->type_max());
-        for (size_t i = 0; i < context->type_max(); ++i)
-        {
-            TetrisMap map(context->width(), context->height());
-            TetrisNode const *node = context->generate(i);
-            node->attach(map);
-            std::memcpy(map_danger_data_[i].data, &map.row[18], sizeof map_danger_data_[i].data);
-            for (int y = 0; y < 3; ++y)
-            {
-                map_danger_data_[i].data[y + 1] |= map_danger_data_[i].data[y];
-            }
-        }
+        feature_.init(context);
     }
 
     std::string TOJ::ai_name() const
@@ -551,202 +480,209 @@ namespace ai_zzz
         }
         t2_value_ref = 0;
         t3_value_ref = 0;
+        //每种坑的第x位表示坑从x列开始,先把整行的x都匹配出来,再从最左边的开始处理
+        uint32_t const t3_l_range = ((1U << (map.width - 2)) - 1) & ~1U;
+        uint32_t const t3_r_range = (1U << (map.width - 3)) - 1;
+        uint32_t const t2_range = (1U << (map.width - 2)) - 1;
         for (int y = 0; y < std::min(20, map.roof - 2); ++y)
         {
-            int new_y = y;
-            int row0 = map.row[y];
-            int row1 = map.row[y + 1];
-            int row2 = y + 2 < map.height ? map.row[y + 2] : 0;
-            int row3 = y + 3 < map.height ? map.row[y + 3] : 0;
-            int row4 = y + 4 < map.height ? map.row[y + 4] : 0;
-            int row5 = y + 5 < map.height ? map.row[y + 5] : 0;
-            int row6 = y + 6 < map.height ? map.row[y + 6] : 0;
+            uint32_t row0 = map.row[y];
+            uint32_t row1 = map.row[y + 1];
+            uint32_t row2 = y + 2 < map.height ? map.row[y + 2] : 0;
+            uint32_t row3 = y + 3 < map.height ? map.row[y + 3] : 0;
+            uint32_t row4 = y + 4 < map.height ? map.row[y + 4] : 0;
+            uint32_t row5 = y + 5 < map.height ? map.row[y + 5] : 0;
+            uint32_t row6 = y + 6 < map.height ? map.row[y + 6] : 0;
             int *row_bit_count = row_bit_count_global + y;
-            for (int x = 1; x < map.width - 2; ++x)
-            {
-                if (((~row0 >> x) & 1) && ((~row1 >> x) & 3) == 3 && ((~row2 >> x) & 1) && ((row3 >> x) & 7) == 0 && ((~row4 >> x) & 6) == 6)
+            //T3的条件除了形状都只和这几行的方块数有关
+            int t3_count = (row_bit_count[0] == map.width - 1) + (row_bit_count[1] == map.width - 2) + 1;
+            int t3_bit_count = row_bit_count[0] + row_bit_count[1] + row_bit_count[2];
+            if (row_bit_count[2] == map.width - 1 && t3_count >= 2 && t3_bit_count > map.width * 2)
+            {
+                //x到x+2列在row3都是空的
+                uint32_t row3_empty = ~(row3 | (row3 >> 1) | (row3 >> 2));
+                //开口朝右,x列是竖着的坑,row4的x+1,x+2空着
+                uint32_t t3_l = ~row0 & ~row1 & (~row1 >> 1) & ~row2 & row3_empty & (~row4 >> 1) & (~row4 >> 2) & t3_l_range;
+                if (t3_l != 0)
                 {
-                    int t3_count = 0;
-                    if (row_bit_count[0] == map.width - 1)
+                    int x = int(ZZZ_TrailingZeros(t3_l));
+                    int t3_value = t3_bit_count * t3_count;
+                    if ((row4 >> x) & 1)
                     {
-                        t3_count += 1;
+                        t3_value += t3_bit_count + row_bit_count[3];
                     }
-                    if (row_bit_count[1] == map.width - 2)
+                    else if (((row4 >> x) & 7) == 1 && ((row5 >> x) & 7) == 1 && ((row6 >> x) & 7) == 1)
                     {
-                        t3_count += 1;
+                        t3_value = 0;
                     }
-                    if (row_bit_count[2] == map.width - 1)
+                    else
                     {
-                        t3_count += 1;
+                        t3_value /= 2;
                     }
-                    else
+                    if (((row3 >> x) & 8) != ((row4 >> x) & 8))
                     {
-                        continue;
+                        t3_value = 0;
                     }
-                    int t3_bit_count = row_bit_count[0] + row_bit_count[1] + row_bit_count[2];
-                    if (t3_count >= 2 && t3_bit_count > map.width * 2)
+                    if (t3_value > 0 && out_map != nullptr)
                     {
-                        int t3_value = t3_bit_count * t3_count;
-                        if ((row4 >> x) & 1)
-                        {
-                            t3_value += t3_bit_count + row_bit_count[3];
-                        }
-                        else if (((row4 >> x) & 7) == 1 && ((row5 >> x) & 7) == 1 && ((row6 >> x) & 7) == 1)
-                        {
-                            t3_value = 0;
-                        }
-                        else
-                        {
-                            t3_value /= 2;
-                        }
-                        if (((row3 >> x) & 8) != ((row4 >> x) & 8))
-                        {
-                            t3_value = 0;
-                        }
-                        if (t3_value > 0 && out_map != nullptr)
-                        {
-                            out_map->row[y + 0] |= 1 << x;
-                            out_map->row[y + 1] |= 3 << x;
-                            out_map->row[y + 2] |= 1 << x;
-                            out_map->row[y + 3] |= 1 << x;
-                        }
-                        t3_value_ref += t3_value;
-                        new_y += 2;
-                        break;
+                        out_map->row[y + 0] |= 1 << x;
+                        out_map->row[y + 1] |= 3 << x;
+                        out_map->row[y + 2] |= 1 << x;
+                        out_map->row[y + 3] |= 1 << x;
                     }
+                    t3_value_ref += t3_value;
+                    y += 2;
+                    continue;
                 }
-            }
-            if (new_y != y)
-            {
-                y = new_y;
-                continue;
-            }
-            for (int x = 0; x < map.width - 3; ++x)
-            {
-                if (((~row0 >> x) & 4) && ((~row1 >> x) & 6) == 6 && ((~row2 >> x) & 4) && ((row3 >> x) & 7) == 0 && ((~row4 >> x) & 3) == 3)
+                //开口朝左,x+2列是竖着的坑,row4的x,x+1空着
+                uint32_t t3_r = (~row0 >> 2) & (~row1 >> 1) & (~row1 >> 2) & (~row2 >> 2) & row3_empty & ~row4 & (~row4 >> 1) & t3_r_range;
+                if (t3_r != 0)
                 {
-                    int t3_count = 0;
-                    if (row_bit_count[0] == map.width - 1)
+                    int x = int(ZZZ_TrailingZeros(t3_r));
+                    int t3_value = t3_bit_count * t3_count;
+                    if ((row2 >> x) & 2)
                     {
-                        t3_count += 1;
+                        t3_value += t3_bit_count;
                     }
-                    if (row_bit_count[1] == map.width - 2)
+                    else if (((row4 >> x) & 7) == 4 && ((row5 >> x) & 7) == 4 && ((row6 >> x) & 7) == 4)
                     {
-                        t3_count += 1;
+                        t3_value = 0;
                     }
-                    if (row_bit_count[2] == map.width - 1)
+                    else
                     {
-                        t3_count += 1;
+                        t3_value /= 4;
                     }
-                    else
+                    if (((row3 >> x) & 1) != ((row4 >> x) & 1))
                     {
-                        continue;
+                        t3_value = 0;
                     }
-                    int t3_bit_count = row_bit_count[0] + row_bit_count[1] + row_bit_count[2];
-                    if (t3_count >= 2 && t3_bit_count > map.width * 2)
+                    if (t3_value > 0 && out_map != nullptr)
                     {
-                        int t3_value = t3_bit_count * t3_count;
-                        if ((row2 >> x) & 2)
-                        {
-                            t3_value += t3_bit_count;
-                        }
-                        else if (((row4 >> x) & 7) == 4 && ((row5 >> x) & 7) == 4 && ((row6 >> x) & 7) == 4)
-                        {
-                            t3_value = 0;
-                        }
-                        else
-                        {
-                            t3_value /= 4;
-                        }
-                        if (((row3 >> x) & 1) != ((row4 >> x) & 1))
-                        {
-                            t3_value = 0;
-                        }
-                        if (t3_value > 0 && out_map != nullptr)
-                        {
-                            out_map->row[y + 0] |= 4 << x;
-                            out_map->row[y + 1] |= 6 << x;
-                            out_map->row[y + 2] |= 4 << x;
-                            out_map->row[y + 3] |= 4 << x;
-                        }
-                        t3_value_ref += t3_value;
-                        new_y += 2;
-                        break;
+                        out_map->row[y + 0] |= 4 << x;
+                        out_map->row[y + 1] |= 6 << x;
+                        out_map->row[y + 2] |= 4 << x;
+                        out_map->row[y + 3] |= 4 << x;
                     }
+                    t3_value_ref += t3_value;
+                    y += 2;
+                    continue;
                 }
             }
-            if (new_y != y)
+            //T2:row0是101,row1的这3格都空着
+            uint32_t t2 = row0 & (~row0 >> 1) & (row0 >> 2) & ~(row1 | (row1 >> 1) | (row1 >> 2)) & t2_range;
+            if (t2 == 0)
             {
-                y = new_y;
                 continue;
             }
-            for (int x = 0; x < map.width - 2; ++x)
+            int row01_count = row_bit_count[0] + row_bit_count[1];
+            if (row01_count <= map.width)
             {
-                if (((row0 >> x) & 7) == 5 && ((row1 >> x) & 7) == 0)
-                {
-                    int row01_count = row_bit_count[0] + row_bit_count[1];
-                    int t2_value = row01_count;
-                    if (row01_count > map.width)
-                    {
-                        if (row_bit_count[0] == map.width - 1)
-                        {
-                            t2_value += row01_count;
-                        }
-                        if (row_bit_count[1] == map.width - 3)
-                        {
-                            t2_value += row01_count;
-                        }
-                        int row2_check = (row2 >> x) & 7;
-                        switch (row2_check)
-                        {
-                        case 1: case 4:
-                            t2_value += row01_count * 3;
-                            break;
-                        case 2: case 3: case 5: case 6: case 7:
-                            t2_value = 0;
-                            break;
-                        default:
-                            t2_value = t2_value / 2;
-                            break;
-                        }
-                        if (t2_value > 0 && out_map != nullptr)
-                        {
-                            out_map->row[y + 0] |= 2 << x;
-                            out_map->row[y + 1] |= 7 << x;
-                        }
-                        t2_value_ref += t2_value;
-                        ++new_y;
-                        break;
-                    }
-                    t2_value_ref += t2_value;
-                }
+                //不够满的时候每个坑都只算方块数,也不跳行
+                t2_value_ref += row01_count * int(ZZZ_BitCount(t2));
+                continue;
+            }
+            int x = int(ZZZ_TrailingZeros(t2));
+            int t2_value = row01_count;
+            if (row_bit_count[0] == map.width - 1)
+            {
+                t2_value += row01_count;
+            }
+            if (row_bit_count[1] == map.width - 3)
+            {
+                t2_value += row01_count;
+            }
+            int row2_check = (row2 >> x) & 7;
+            switch (row2_check)
+            {
+            case 1: case 4:
+                t2_value += row01_count * 3;
+                break;
+            case 2: case 3: case 5: case 6: case 7:
+                t2_value = 0;
+                break;
+            default:
+                t2_value = t2_value / 2;
+                break;
+            }
+            if (t2_value > 0 && out_map != nullptr)
+            {
+                out_map->row[y + 0] |= 2 << x;
+                out_map->row[y + 1] |= 7 << x;
             }
-            y = new_y;
+            t2_value_ref += t2_value;
+            ++y;
         }
     };
 
     TOJ::Result TOJ::eval(TetrisNodeEx const &node, TetrisMap const &map, TetrisMap const &src_map, size_t clear) const
     {
-        const int width_m1 = map.width - 1;
-
         Result result;
         memset(&result, 0, sizeof result);
 
         TetrisMap t_map = map;
         Status::init_t_value(t_map, result.t2_value, result.t3_value, &t_map);
 
-        size_t ColTrans = 2 * (t_map.height - t_map.roof);
-        size_t RowTrans = t_map.roof == t_map.height ? 0 : t_map.width;
-        for (int y = 0; y < t_map.roof; ++y)
+        Feature feature;
+        eval_feature_(t_map, feature);
+        eval_result_(node, t_map, clear, feature, result);
+        return result;
+    }
+
+    void TOJ::eval_batch(size_t count, TetrisNodeEx const *const *node, TetrisMap const *const *map, size_t const *clear, TetrisMap const &src_map, Result *const *result) const
+    {
+#if __SSE4_2__
+        TetrisMap t_map[4] = { src_map, src_map, src_map, src_map };
+        Feature feature[4];
+        for (size_t i = 0; i < count; i += 4)
         {
-            ColTrans += !t_map.full(0, y) + !t_map.full(width_m1, y) + ZZZ_BitCount((t_map.row[y] ^ (t_map.row[y] << 1)) & col_mask_);
-            if (y != 0)
+            size_t lane = std::min<size_t>(4, count - i);
+            for (size_t j = 0; j < lane; ++j)
+            {
+                Result &r = *result[i + j];
+                memset(&r, 0, sizeof r);
+                t_map[j] = *map[i + j];
+                Status::init_t_value(t_map[j], r.t2_value, r.t3_value, &t_map[j]);
+            }
+            //空着的通道复制第一个场景凑数
+            for (size_t j = lane; j < 4; ++j)
+            {
+                t_map[j] = t_map[0];
+            }
+            bool simd = true;
+            for (size_t j = 0; j < 4; ++j)
+            {
+                simd = simd && t_map[j].roof != 0 && t_map[j].roof != t_map[j].height;
+            }
+            if (simd)
             {
-                RowTrans += ZZZ_BitCount(t_map.row[y - 1] ^ t_map.row[y]);
+                eval_feature_4_(t_map, feature);
             }
+            else
+            {
+                //场景空了或者顶满了,和eval走一样的路
+                for (size_t j = 0; j < lane; ++j)
+                {
+                    eval_feature_(t_map[j], feature[j]);
+                }
+            }
+            for (size_t j = 0; j < lane; ++j)
+            {
+                eval_result_(*node[i + j], t_map[j], clear[i + j], feature[j], *result[i + j]);
+            }
+        }
+#else
+        for (size_t i = 0; i < count; ++i)
+        {
+            *result[i] = eval(*node[i], *map[i], src_map, clear[i]);
         }
-        RowTrans += ZZZ_BitCount(row_mask_ & ~t_map.row[0]);
-        RowTrans += ZZZ_BitCount(t_map.roof == t_map.height ? row_mask_ & ~t_map.row[t_map.roof - 1] : t_map.row[t_map.roof - 1]);
+#endif
+    }
+
+    void TOJ::eval_feature_(TetrisMap const &t_map, Feature &feature) const
+    {
+        auto trans = feature_.trans_wall(t_map);
+        size_t ColTrans = trans.col;
+        size_t RowTrans = trans.row;
         struct
         {
             int HoleCount;
@@ -783,23 +719,133 @@ namespace ai_zzz
                 ++v.Wide[WideCount];
             }
         }
-        double BoardDeadZone = map_in_danger_(t_map, 0);
+        feature.col_trans = int(ColTrans);
+        feature.row_trans = int(RowTrans);
+        feature.hole_count = v.HoleCount;
+        feature.hole_line = v.HoleLine;
+        feature.clear_width = v.ClearWidth;
+        feature.wide_2 = v.Wide[2];
+        feature.wide_3 = v.Wide[3];
+        feature.wide_4 = v.Wide[4];
+    }
+
+#if __SSE4_2__
+    namespace
+    {
+        //每个32位通道里1的个数
+        inline __m128i popcnt_epi32(__m128i v)
+        {
+            __m128i const lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            __m128i const low = _mm_set1_epi8(0x0f);
+            __m128i c = _mm_add_epi8(_mm_shuffle_epi8(lut, _mm_and_si128(v, low)), _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), low)));
+            return _mm_madd_epi16(_mm_maddubs_epi16(c, _mm_set1_epi8(1)), _mm_set1_epi16(1));
+        }
+    }
+
+    //和eval_feature_逐项对应,各通道roof以上的行当成0,所以可以统一按最高的roof算
+    void TOJ::eval_feature_4_(TetrisMap const *t_map, Feature *feature) const
+    {
+        int const width = t_map[0].width;
+        int roof_max = std::max(std::max(t_map[0].roof, t_map[1].roof), std::max(t_map[2].roof, t_map[3].roof));
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const one = _mm_set1_epi32(1);
+        __m128i const width_v = _mm_set1_epi32(width);
+        __m128i const left = _mm_set1_epi32(1);
+        __m128i const right = _mm_set1_epi32(1 << (width - 1));
+        __m128i const col_mask = _mm_set1_epi32(feature_.col_mask());
+        __m128i const roof = _mm_setr_epi32(t_map[0].roof, t_map[1].roof, t_map[2].roof, t_map[3].roof);
+        __m128i row[max_height + 1];
+        __m128i clear_term[max_height];
+        for (int y = 0; y < roof_max; ++y)
+        {
+            //init_t_value补的T块可能伸到roof以上,eval不看那些行
+            row[y] = _mm_and_si128(_mm_setr_epi32(t_map[0].row[y], t_map[1].row[y], t_map[2].row[y], t_map[3].row[y]), _mm_cmpgt_epi32(roof, _mm_set1_epi32(y)));
+            clear_term[y] = _mm_mullo_epi32(_mm_sub_epi32(width_v, popcnt_epi32(row[y])), _mm_set1_epi32(y));
+        }
+        row[roof_max] = zero;
+
+        //roof以上的行左右两格是空的,正好补上2*(roof_max-roof)
+        __m128i col_trans = _mm_set1_epi32(2 * (t_map[0].height - roof_max));
+        __m128i row_trans = _mm_add_epi32(width_v, popcnt_epi32(_mm_andnot_si128(row[0], _mm_set1_epi32(feature_.row_mask()))));
+        for (int y = 0; y < roof_max; ++y)
+        {
+            __m128i r = row[y];
+            col_trans = _mm_sub_epi32(col_trans, _mm_cmpeq_epi32(_mm_and_si128(r, left), zero));
+            col_trans = _mm_sub_epi32(col_trans, _mm_cmpeq_epi32(_mm_and_si128(r, right), zero));
+            col_trans = _mm_add_epi32(col_trans, popcnt_epi32(_mm_and_si128(_mm_xor_si128(r, _mm_slli_epi32(r, 1)), col_mask)));
+            row_trans = _mm_add_epi32(row_trans, popcnt_epi32(_mm_xor_si128(r, row[y + 1])));
+        }
+
+        __m128i cover = zero;
+        __m128i hole_any = zero;
+        __m128i hole_count = zero;
+        __m128i hole_line = zero;
+        __m128i clear_width = zero;
+        __m128i wide = _mm_set1_epi32(width - 1);
+        __m128i wide_2 = zero;
+        __m128i wide_3 = zero;
+        __m128i wide_4 = zero;
+        for (int y = roof_max - 1; y >= 0; --y)
+        {
+            cover = _mm_or_si128(cover, row[y]);
+            __m128i hole = _mm_andnot_si128(row[y], cover);
+            if (!_mm_testz_si128(hole, hole))
+            {
+                hole_count = _mm_add_epi32(hole_count, popcnt_epi32(hole));
+                hole_line = _mm_add_epi32(hole_line, _mm_andnot_si128(_mm_cmpeq_epi32(hole, zero), one));
+                for (int hy = y + 1, hy_max = std::min(roof_max, hy + 8); hy < hy_max; ++hy)
+                {
+                    clear_width = _mm_add_epi32(clear_width, _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(hole, row[hy]), zero), clear_term[hy]));
+                }
+                hole_any = _mm_or_si128(hole_any, hole);
+            }
+            wide = _mm_min_epi32(wide, _mm_sub_epi32(width_v, popcnt_epi32(cover)));
+            //还没有洞,并且在这个场景的roof以下
+            __m128i open = _mm_and_si128(_mm_cmpeq_epi32(hole_any, zero), _mm_cmpgt_epi32(roof, _mm_set1_epi32(y)));
+            wide_2 = _mm_sub_epi32(wide_2, _mm_and_si128(open, _mm_cmpeq_epi32(wide, _mm_set1_epi32(2))));
+            wide_3 = _mm_sub_epi32(wide_3, _mm_and_si128(open, _mm_cmpeq_epi32(wide, _mm_set1_epi32(3))));
+            wide_4 = _mm_sub_epi32(wide_4, _mm_and_si128(open, _mm_cmpeq_epi32(wide, _mm_set1_epi32(4))));
+        }
+        int32_t out[8][4];
+        _mm_storeu_si128((__m128i *)out[0], col_trans);
+        _mm_storeu_si128((__m128i *)out[1], row_trans);
+        _mm_storeu_si128((__m128i *)out[2], hole_count);
+        _mm_storeu_si128((__m128i *)out[3], hole_line);
+        _mm_storeu_si128((__m128i *)out[4], clear_width);
+        _mm_storeu_si128((__m128i *)out[5], wide_2);
+        _mm_storeu_si128((__m128i *)out[6], wide_3);
+        _mm_storeu_si128((__m128i *)out[7], wide_4);
+        for (size_t i = 0; i < 4; ++i)
+        {
+            feature[i].col_trans = out[0][i];
+            feature[i].row_trans = out[1][i];
+            feature[i].hole_count = out[2][i];
+            feature[i].hole_line = out[3][i];
+            feature[i].clear_width = out[4][i];
+            feature[i].wide_2 = out[5][i];
+            feature[i].wide_3 = out[6][i];
+            feature[i].wide_4 = out[7][i];
+        }
+    }
+#endif
+
+    void TOJ::eval_result_(TetrisNodeEx const &node, TetrisMap const &t_map, size_t clear, Feature const &feature, Result &result) const
+    {
         auto& p = config_->param;
         result.value = (0.
             - t_map.roof * p.roof
-            - ColTrans * p.col_trans
-            - RowTrans * p.row_trans
-            - v.HoleCount * p.hole_count
-            - v.HoleLine * p.hole_line
-            - v.ClearWidth * p.clear_width
-            + v.Wide[2] * p.wide_2
-            + v.Wide[3] * p.wide_3
-            + v.Wide[4] * p.wide_4
+            - feature.col_trans * p.col_trans
+            - feature.row_trans * p.row_trans
+            - feature.hole_count * p.hole_count
+            - feature.hole_line * p.hole_line
+            - feature.clear_width * p.clear_width
+            + feature.wide_2 * p.wide_2
+            + feature.wide_3 * p.wide_3
+            + feature.wide_4 * p.wide_4
             );
         result.count = t_map.count;
         result.clear = int8_t(clear);
         result.safe = node->row >= 20 ? -1 : get_safe(t_map);
-        return result;
     }
 
     TOJ::Status TOJ::get(TetrisNodeEx &node, Result const &eval_result, size_t depth, Status const &status, TetrisContext::Env const &env) const
@@ -1001,24 +1047,6 @@ namespace ai_zzz
         return result;
     }
 
-    size_t TOJ::map_in_danger_(m_tetris::TetrisMap const &map, size_t up) const
-    {
-        size_t danger = 0;
-        for (size_t i = 0; i < context_->type_max(); ++i)
-        {
-            if (up >= 18)
-            {
-                return context_->type_max();
-            }
-            size_t height = 22 - up;
-            if (((map_danger_data_[i].data[0] & map.row[height - 4]) | (map_danger_data_[i].data[1] & map.row[height - 3]) | (map_danger_data_[i].data[2] & map.row[height - 2]) | (map_danger_data_[i].data[3] & map.row[height - 1])) != 0)
-            {
-                ++danger;
-            }
-        }
-        return danger;
-    }
-
 
     bool TOJ_v08::Status::operator < (Status const &other) const
     {
@@ -1029,21 +1057,8 @@ namespace ai_zzz
     {
         context_ = context;
         config_ = config;
-        col_mask_ = context->full() & ~1;
-        row_mask_ = context->full();
+        feature_.init(context);
         full_count_ = context->width() * 24;
-        map_danger_data_.resize(context->type_max());
-        for (size_t i = 0; i < context->type_max(); ++i)
-        {
-            TetrisMap map(context->width(), context->height());
-            TetrisNode const *node = context->generate(i);
-            node->attach(map);
-            std::memcpy(map_danger_data_[i].data, &map.row[18], sizeof map_danger_data_[i].data);
-            for (int y = 0; y < 3; ++y)
-            {
-                map_danger_data_[i].data[y + 1] |= map_danger_data_[i].data[y];
-            }
-        }
     }
 
     std::string TOJ_v08::ai_name() const
@@ -1054,26 +1069,9 @@ namespace ai_zzz
     TOJ_v08::Result TOJ_v08::eval(TetrisNodeEx const &node, m_tetris::TetrisMap const &map, m_tetris::TetrisMap const &src_map, size_t clear) const
     {
         const int width_m1 = map.width - 1;
-        int ColTrans = 2 * (map.height - map.roof);
-        int RowTrans = map.roof == map.height ? 0 : map.width;
-        for (int y = 0; y < map.roof; ++y)
-        {
-            if (!map.full(0, y))
-            {
-                ++ColTrans;
-            }
-            if (!map.full(width_m1, y))
-            {
-                ++ColTrans;
-            }
-            ColTrans += ZZZ_BitCount((map.row[y] ^ (map.row[y] << 1)) & col_mask_);
-            if (y != 0)
-            {
-                RowTrans += ZZZ_BitCount(map.row[y - 1] ^ map.row[y]);
-            }
-        }
-        RowTrans += ZZZ_BitCount(row_mask_ & ~map.row[0]);
-        RowTrans += ZZZ_BitCount(map.roof == map.height ? row_mask_ & ~map.row[map.roof - 1] : map.row[map.roof - 1]);
+        auto trans = feature_.trans_wall(map);
+        int ColTrans = trans.col;
+        int RowTrans = trans.row;
         struct
         {
             int HoleCount;
@@ -1172,7 +1170,7 @@ namespace ai_zzz
         result.count = map.count + v.HoleCount;
         result.clear = clear;
         result.safe = 0;
-        while (map_in_danger_(map, result.safe + 1) == 0)
+        while (result.safe + 1 < 19 && !context_->map_in_danger(map, 18, 17 - result.safe))
         {
             ++result.safe;
         }
@@ -1436,24 +1434,6 @@ namespace ai_zzz
         return result;
     }
 
-    size_t TOJ_v08::map_in_danger_(m_tetris::TetrisMap const &map, size_t up) const
-    {
-        size_t danger = 0;
-        for (size_t i = 0; i < context_->type_max(); ++i)
-        {
-            if (up >= 20)
-            {
-                return context_->type_max();
-            }
-            size_t height = 22 - up;
-            if (map_danger_data_[i].data[0] & map.row[height - 4] || map_danger_data_[i].data[1] & map.row[height - 3] || map_danger_data_[i].data[2] & map.row[height - 2] || map_danger_data_[i].data[3] & map.row[height - 1])
-            {
-                ++danger;
-            }
-        }
-        return danger;
-    }
-
     bool C2::Status::operator < (Status const &other) const
     {
         return value < other.value;
@@ -1464,20 +1444,7 @@ namespace ai_zzz
     {
         context_ = context;
         config_ = config;
-        map_danger_data_.resize(context->type_max());
-        for (size_t i = 0; i < context->type_max(); ++i)
-        {
-            TetrisMap map(context->width(), context->height());
-            TetrisNode const *node = context->generate(i);
-            node->move_down->attach(map);
-            std::memcpy(map_danger_data_[i].data, &map.row[map.height - 4], sizeof map_danger_data_[i].data);
-            for (int y = 0; y < 3; ++y)
-            {
-                map_danger_data_[i].data[y + 1] |= map_danger_data_[i].data[y];
-            }
-        }
-        col_mask_ = context->full() & ~1;
-        row_mask_ = context->full();
+        feature_.init(context);
     }
 
     std::string C2::ai_name() const
@@ -1488,18 +1455,9 @@ namespace ai_zzz
     C2::Result C2::eval(TetrisNode const *node, TetrisMap const &map, TetrisMap const &src_map, size_t clear) const
     {
         const int width_m1 = map.width - 1;
-        size_t ColTrans = 2 * (map.height - map.roof);
-        size_t RowTrans = map.roof == map.height ? 0 : map.width;
-        for (int y = 0; y < map.roof; ++y)
-        {
-            ColTrans += !map.full(0, y) + !map.full(width_m1, y) + ZZZ_BitCount((map.row[y] ^ (map.row[y] << 1)) & col_mask_);
-            if (y != 0)
-            {
-                RowTrans += ZZZ_BitCount(map.row[y - 1] ^ map.row[y]);
-            }
-        }
-        RowTrans += ZZZ_BitCount(row_mask_ & ~map.row[0]);
-        RowTrans += ZZZ_BitCount(map.roof == map.height ? row_mask_ & ~map.row[map.roof - 1] : map.row[map.roof - 1]);
+        auto trans = feature_.trans_wall(map);
+        size_t ColTrans = trans.col;
+        size_t RowTrans = trans.row;
         struct
         {
             int HoleCountSrc;
@@ -1791,14 +1749,7 @@ namespace ai_zzz
 
     size_t C2::map_in_danger_(m_tetris::TetrisMap const &map) const
     {
-        size_t danger = 0;
-        for (size_t i = 0; i < context_->type_max(); ++i)
-        {
-            if (map_danger_data_[i].data[0] & map.row[map.height - 4] || map_danger_data_[i].data[1] & map.row[map.height - 3] || map_danger_data_[i].data[2] & map.row[map.height - 2] || map_danger_data_[i].data[3] & map.row[map.height - 1])
-            {
-                ++danger;
-            }
-        }
+        size_t danger = context_->map_danger(map, context_->height() - 3, map.height - 4);
         if (map.row[17] != 0)
         {
             ++danger;
@@ -1,5 +1,6 @@
 ﻿
 #include "tetris_core.h"
+#include "tetris_feature.h"
 #include "search_tspin.h"
 #include <array>
 
@@ -28,6 +29,10 @@ namespace ai_zzz
                 double rubbish;
                 double value;
                 bool operator < (Status const &) const;
+                double key() const
+                {
+                    return value;
+                }
             };
         public:
             void init(m_tetris::TetrisContext const *context, Config const *config);
@@ -42,12 +47,7 @@ namespace ai_zzz
             uint32_t *check_line_2_end_;
             Config const *config_;
             m_tetris::TetrisContext const *context_;
-            int col_mask_, row_mask_;
-            struct MapInDangerData
-            {
-                uint32_t data[4];
-            };
-            std::vector<MapInDangerData> map_danger_data_;
+            m_tetris::TetrisFeature feature_;
             size_t map_in_danger_(m_tetris::TetrisMap const &map) const;
         };
     }
@@ -78,15 +78,10 @@ namespace ai_zzz
         double eval(m_tetris::TetrisNode const *node, m_tetris::TetrisMap const &map, m_tetris::TetrisMap const &src_map, size_t clear) const;
         double get(m_tetris::TetrisNode const *node, double const &eval_result) const;
     private:
-        struct MapInDangerData
-        {
-            int data[4];
-        };
-        std::vector<MapInDangerData> map_danger_data_;
         m_tetris::TetrisContext const *context_;
         Config const *config_;
         size_t map_in_danger_(m_tetris::TetrisMap const &map) const;
-        int col_mask_, row_mask_;
+        m_tetris::TetrisFeature feature_;
     };
 
     class TOJ_v08
@@ -121,6 +116,10 @@ namespace ai_zzz
             double like;
             double value;
             bool operator < (Status const &) const;
+            double key() const
+            {
+                return value;
+            }
         };
     public:
         void init(m_tetris::TetrisContext const *context, Config const *config);
@@ -134,14 +133,8 @@ namespace ai_zzz
     private:
         m_tetris::TetrisContext const *context_;
         Config const *config_;
-        int col_mask_, row_mask_;
+        m_tetris::TetrisFeature feature_;
         int full_count_;
-        struct MapInDangerData
-        {
-            int data[4];
-        };
-        std::vector<MapInDangerData> map_danger_data_;
-        size_t map_in_danger_(m_tetris::TetrisMap const &map, size_t up) const;
     };
 
     class TOJ
@@ -210,6 +203,20 @@ namespace ai_zzz
             double like;
             double value;
             bool operator < (Status const &) const;
+            double key() const
+            {
+                return value;
+            }
+            //会影响后续评价的状态,搜索树合并置换节点用
+            //like会乘1.3带进子节点,只取float的符号,指数和高8位尾数,相差不到1/256的才合并
+            //这样丢掉分低的那个仍然是近似的,置换表要自己打开(TetrisEngine::transposition)
+            uint64_t transposition_key() const
+            {
+                float like_float = float(like);
+                uint32_t like_bits;
+                std::memcpy(&like_bits, &like_float, sizeof like_bits);
+                return uint64_t(uint8_t(death)) | uint64_t(uint8_t(combo)) << 8 | uint64_t(uint8_t(under_attack)) << 16 | uint64_t(uint8_t(map_rise)) << 24 | uint64_t(uint8_t(b2b)) << 32 | uint64_t(like_bits >> 15) << 40;
+            }
 
             static void init_t_value(m_tetris::TetrisMap const &m, int16_t &t2_value_ref, int16_t &t3_value_ref, m_tetris::TetrisMap *out_map = nullptr);
         };
@@ -222,17 +229,29 @@ namespace ai_zzz
             return config_->param.ratio;
         }
         Result eval(TetrisNodeEx const &node, m_tetris::TetrisMap const &map, m_tetris::TetrisMap const &src_map, size_t clear) const;
+        //一次评价同一个场景展开的一组子节点,结果和逐个eval一样
+        void eval_batch(size_t count, TetrisNodeEx const *const *node, m_tetris::TetrisMap const *const *map, size_t const *clear, m_tetris::TetrisMap const &src_map, Result *const *result) const;
         Status get(TetrisNodeEx &node, Result const &eval_result, size_t depth, Status const & status, m_tetris::TetrisContext::Env const &env) const;
     private:
         m_tetris::TetrisContext const *context_;
         Config const *config_;
-        int col_mask_, row_mask_;
-        struct MapInDangerData
+        m_tetris::TetrisFeature feature_;
+        //eval里和场景形状有关的几项
+        struct Feature
         {
-            int data[4];
+            int col_trans;
+            int row_trans;
+            int hole_count;
+            int hole_line;
+            int clear_width;
+            int wide_2;
+            int wide_3;
+            int wide_4;
         };
-        std::vector<MapInDangerData> map_danger_data_;
-        size_t map_in_danger_(m_tetris::TetrisMap const &map, size_t up) const;
+        void eval_feature_(m_tetris::TetrisMap const &t_map, Feature &feature) const;
+        //4个场景一起算,每个场景占一个32位通道
+        void eval_feature_4_(m_tetris::TetrisMap const *t_map, Feature *feature) const;
+        void eval_result_(TetrisNodeEx const &node, m_tetris::TetrisMap const &t_map, size_t clear, Feature const &feature, Result &result) const;
     };
 
     class C2
@@ -255,6 +274,10 @@ namespace ai_zzz
             size_t combo_limit;
             double value;
             bool operator < (Status const &) const;
+            double key() const
+            {
+                return value;
+            }
         };
         struct Result
         {
@@ -276,12 +299,7 @@ namespace ai_zzz
     private:
         m_tetris::TetrisContext const *context_;
         Config const *config_;
-        int col_mask_, row_mask_;
-        struct MapInDangerData
-        {
-            int data[4];
-        };
-        std::vector<MapInDangerData> map_danger_data_;
+        m_tetris::TetrisFeature feature_;
         size_t map_in_danger_(m_tetris::TetrisMap const &map) const;
     };
 
@@ -0,0 +1,219 @@
+﻿//TetrisContext的出生危险掩码和原来各个AI自己建表的写法对照
+#include "tetris_core.h"
+#include "integer_utils.h"
+#include "search_simple.h"
+#include "ai_zzz.h"
+#include "ai_ax.h"
+#include "rule_srs.h"
+#include "rule_toj.h"
+#include "rule_st.h"
+#include "rule_qq.h"
+#include "rule_c2.h"
+#include "rule_tag.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+//原来各个AI自己建表的写法,用来对照
+struct DangerRef
+{
+    struct Data
+    {
+        uint32_t data[4];
+    };
+    std::vector<Data> danger;
+    //move_down:出生块往下移一格再算,base:取出生块的哪4行
+    void init(m_tetris::TetrisContext const *context, bool move_down, int base)
+    {
+        danger.resize(context->type_max());
+        for (size_t i = 0; i < context->type_max(); ++i)
+        {
+            m_tetris::TetrisMap map(context->width(), context->height());
+            m_tetris::TetrisNode const *node = context->generate(i);
+            (move_down ? node->move_down.get() : node)->attach(map);
+            std::memcpy(danger[i].data, &map.row[base], sizeof danger[i].data);
+            for (int y = 0; y < 3; ++y)
+            {
+                danger[i].data[y + 1] |= danger[i].data[y];
+            }
+        }
+    }
+    bool check(size_t i, m_tetris::TetrisMap const &map, int row) const
+    {
+        return (danger[i].data[0] & map.row[row]) || (danger[i].data[1] & map.row[row + 1]) || (danger[i].data[2] & map.row[row + 2]) || (danger[i].data[3] & map.row[row + 3]);
+    }
+    size_t count(m_tetris::TetrisMap const &map, int row) const
+    {
+        size_t result = 0;
+        for (size_t i = 0; i < danger.size(); ++i)
+        {
+            result += check(i, map, row);
+        }
+        return result;
+    }
+    //ai_tag的写法,每种块往下看up行,有一行挡住就算
+    size_t count_up(m_tetris::TetrisMap const &map, size_t up) const
+    {
+        size_t result = 0;
+        for (size_t i = 0; i < danger.size(); ++i)
+        {
+            for (size_t check_up = 0; check_up <= up; ++check_up)
+            {
+                if (check(i, map, map.height - int(check_up) - 4))
+                {
+                    ++result;
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+    //TOJ的写法,limit行以上直接当作危险
+    int safe(m_tetris::TetrisMap const &map, int limit) const
+    {
+        int result = 0;
+        while (result + 1 < limit && count(map, 17 - result) == 0)
+        {
+            ++result;
+        }
+        return result;
+    }
+};
+
+//随机高度随机密度的场景,让出生位置附近的行也有方块
+m_tetris::TetrisMap make_map(m_tetris::TetrisContext const *context, std::mt19937 &r)
+{
+    m_tetris::TetrisMap map(context->width(), context->height());
+    int roof = r() % (context->height() + 1);
+    int density = 1 + r() % 8;
+    for (int y = 0; y < roof; ++y)
+    {
+        for (int x = 0; x < context->width(); ++x)
+        {
+            if (int(r() % 8) < density)
+            {
+                map.row[y] |= 1 << x;
+            }
+        }
+        map.row[y] &= context->full() & ~(1U << (r() % context->width()));
+    }
+    for (int y = 0; y < map.height; ++y)
+    {
+        if (map.row[y] == 0)
+        {
+            continue;
+        }
+        map.roof = y + 1;
+        map.count += int(ZZZ_BitCount(map.row[y]));
+        for (int x = 0; x < map.width; ++x)
+        {
+            if (map.full(x, y))
+            {
+                map.top[x] = y + 1;
+            }
+        }
+    }
+    map.rehash();
+    return map;
+}
+
+//the_ai_games的写法,每种块往下看up行,有一行挡住就算
+size_t count_up(m_tetris::TetrisContext const *context, m_tetris::TetrisMap const &map, size_t up)
+{
+    m_tetris::TetrisDangerMask const *mask = context->danger_mask(context->height() - 3);
+    size_t danger = 0;
+    for (size_t i = 0; i < context->type_max(); ++i)
+    {
+        for (size_t check_up = 0; check_up <= up; ++check_up)
+        {
+            if (mask[i].check(map, map.height - int(check_up) - 4))
+            {
+                ++danger;
+                break;
+            }
+        }
+    }
+    return danger;
+}
+
+//TetrisContext的危险判定和原来的写法逐个场景对照
+template<class TetrisRule>
+void run(char const *rule_name, int width, int height, size_t count)
+{
+    m_tetris::TetrisEngine<TetrisRule, ai_ax::AI, search_simple::Search> engine;
+    if (!engine.prepare(width, height))
+    {
+        std::cout << rule_name << " prepare failed" << std::endl;
+        return;
+    }
+    m_tetris::TetrisContext const *context = engine.context().get();
+
+    DangerRef ref_top, ref_top_down, ref_18;
+    ref_top.init(context, false, height - 4);
+    ref_top_down.init(context, true, height - 4);
+    ref_18.init(context, false, 18);
+
+    ai_zzz::TOJ toj;
+    ai_zzz::TOJ::Config toj_config = {};
+    toj.init(context, &toj_config);
+    ai_zzz::TOJ_v08 toj_v08;
+    ai_zzz::TOJ_v08::Config toj_v08_config = {};
+    toj_v08.init(context, &toj_v08_config);
+
+    //各个AI调TetrisContext的方式,C2在这之外还要加上第17行的判定
+    enum
+    {
+        top_index, top_down_index, in_danger_index, up_index, toj_index, toj_v08_index, ai_max
+    };
+    char const *name[ai_max] = { "map_danger(h-4) ai_ax/Attack/Dig", "map_danger(h-3) C2", "map_in_danger(h-4)", "danger_mask(h-3) the_ai_games", "TOJ::get_safe", "TOJ_v08::eval safe" };
+    size_t mismatch[ai_max] = {}, danger[ai_max] = {};
+    std::mt19937 r(1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_tetris::TetrisMap map = make_map(context, r);
+        size_t up = r() % 4;
+        size_t expect[ai_max] =
+        {
+            ref_top.count(map, height - 4),
+            ref_top_down.count(map, height - 4),
+            ref_top.count(map, height - 4) != 0,
+            ref_top_down.count_up(map, up),
+            size_t(ref_18.safe(map, 18)),
+            //原来到up==19会读到row[-1],现在和那之前一样停在19
+            size_t(ref_18.safe(map, 19)),
+        };
+        size_t result[ai_max] =
+        {
+            context->map_danger(map, height - 4, map.height - 4),
+            context->map_danger(map, height - 3, map.height - 4),
+            context->map_in_danger(map, height - 4, map.height - 4),
+            count_up(context, map, up),
+            size_t(toj.get_safe(map)),
+            size_t(toj_v08.eval(context->generate(size_t(0)), map, map, 0).safe),
+        };
+        for (size_t j = 0; j < ai_max; ++j)
+        {
+            mismatch[j] += result[j] != expect[j];
+            danger[j] += expect[j] != 0;
+        }
+    }
+    std::cout << rule_name << " " << width << "x" << height << " map=" << count << std::endl;
+    for (size_t j = 0; j < ai_max; ++j)
+    {
+        std::cout << "    " << name[j] << " mismatch=" << mismatch[j] << " nonzero=" << danger[j] << std::endl;
+    }
+}
+
+//用法: danger_test [每种规则的场景数]
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? atoi(argv[1]) : 50000;
+    run<rule_srs::TetrisRule>("rule_srs", 10, 40, count);
+    run<rule_toj::TetrisRule>("rule_toj", 10, 40, count);
+    run<rule_st::TetrisRule>("rule_st", 10, 20, count);
+    run<rule_qq::TetrisRule>("rule_qq", 10, 20, count);
+    run<rule_c2::TetrisRule>("rule_c2", 10, 21, count);
+    run<rule_tag::TetrisRule>("rule_tag", 10, 20, count);
+}
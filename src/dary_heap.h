@@ -0,0 +1,153 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace zzz
+{
+    //d叉堆,比较键和值一起存在数组里,比较时不用再解引用值
+    //key_of_t从值取比较键,只在放进堆时调用一次;堆顶是按less_t最大的
+    template<class value_t, class key_of_t, size_t arity = 4, class less_t = std::less<typename std::decay<decltype(key_of_t()(std::declval<value_t const &>()))>::type>>
+    class dary_heap
+    {
+        static_assert(arity >= 2, "arity must be at least 2");
+    public:
+        typedef value_t value_type;
+        typedef typename std::decay<decltype(key_of_t()(std::declval<value_t const &>()))>::type key_type;
+        typedef size_t size_type;
+    private:
+        struct entry_t
+        {
+            key_type key;
+            value_t value;
+        };
+        std::vector<entry_t> data_;
+        less_t less_;
+
+    public:
+        dary_heap() : data_(), less_()
+        {
+        }
+        bool empty() const
+        {
+            return data_.empty();
+        }
+        size_t size() const
+        {
+            return data_.size();
+        }
+        value_t const &top() const
+        {
+            return data_.front().value;
+        }
+        key_type const &top_key() const
+        {
+            return data_.front().key;
+        }
+        void push(value_t const &value)
+        {
+            data_.push_back(entry_t{key_of_t()(value), value});
+            sift_up_(data_.size() - 1);
+        }
+        //一次放进一组,数量比堆里已有的多时整体重新建堆
+        template<class iterator_t>
+        void push(iterator_t begin, iterator_t end)
+        {
+            size_t old_size = data_.size();
+            for (; begin != end; ++begin)
+            {
+                data_.push_back(entry_t{key_of_t()(*begin), *begin});
+            }
+            size_t count = data_.size() - old_size;
+            if (count > old_size)
+            {
+                for (size_t i = parent_(data_.size() - 1) + 1; i-- > 0; )
+                {
+                    sift_down_(i);
+                }
+            }
+            else
+            {
+                for (size_t i = old_size; i < data_.size(); ++i)
+                {
+                    sift_up_(i);
+                }
+            }
+        }
+        void pop()
+        {
+            if (data_.size() > 1)
+            {
+                data_.front() = std::move(data_.back());
+                data_.pop_back();
+                sift_down_(0);
+            }
+            else
+            {
+                data_.pop_back();
+            }
+        }
+        void clear()
+        {
+            data_.clear();
+        }
+        void reserve(size_t size)
+        {
+            data_.reserve(size);
+        }
+
+    private:
+        static size_t parent_(size_t index)
+        {
+            return index == 0 ? 0 : (index - 1) / arity;
+        }
+        void sift_up_(size_t index)
+        {
+            entry_t entry = std::move(data_[index]);
+            while (index > 0)
+            {
+                size_t parent = (index - 1) / arity;
+                if (!less_(data_[parent].key, entry.key))
+                {
+                    break;
+                }
+                data_[index] = std::move(data_[parent]);
+                index = parent;
+            }
+            data_[index] = std::move(entry);
+        }
+        void sift_down_(size_t index)
+        {
+            size_t size = data_.size();
+            entry_t entry = std::move(data_[index]);
+            while (true)
+            {
+                size_t first = index * arity + 1;
+                if (first >= size)
+                {
+                    break;
+                }
+                size_t last = first + arity < size ? first + arity : size;
+                size_t best = first;
+                for (size_t i = first + 1; i < last; ++i)
+                {
+                    if (less_(data_[best].key, data_[i].key))
+                    {
+                        best = i;
+                    }
+                }
+                if (!less_(entry.key, data_[best].key))
+                {
+                    break;
+                }
+                data_[index] = std::move(data_[best]);
+                index = best;
+            }
+            data_[index] = std::move(entry);
+        }
+    };
+}
@@ -68,6 +68,7 @@ extern "C" DECLSPEC_EXPORT int WINAPI AIPath(int boardW, int boardH, char board[
             }
         }
     }
+    map.rehash();
     m_tetris::TetrisBlockStatus status(curPiece, curX - 1, curY - 1, curR - 1);
     std::string next;
     if(nextPiece != ' ')
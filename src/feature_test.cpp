@@ -0,0 +1,283 @@
+﻿#include "tetris_core.h"
+#include "tetris_feature.h"
+#include "integer_utils.h"
+#include "search_tspin.h"
+#include "search_tag.h"
+#include "ai_zzz.h"
+#include "ai_ax.h"
+#include "ai_tag.h"
+#include "rule_srs.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef m_tetris::TetrisEngine<rule_srs::TetrisRule, ai_zzz::TOJ, search_tspin::Search> engine_t;
+
+int const combo_table[] = { 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 4, 5 };
+
+struct Sample
+{
+    m_tetris::TetrisNode const *node;
+    m_tetris::TetrisMap src_map;
+    m_tetris::TetrisMap map;
+    size_t clear;
+};
+
+//原来各个AI里的写法,用来对照
+void trans_ref(m_tetris::TetrisMap const &map, uint32_t col_mask, uint32_t row_mask, bool wall, int &col, int &row)
+{
+    const int width_m1 = map.width - 1;
+    col = 2 * (map.height - map.roof);
+    row = wall ? (map.roof == map.height ? 0 : map.width) + ZZZ_BitCount(row_mask & ~map.row[0]) + ZZZ_BitCount(map.roof == map.height ? row_mask & ~map.row[map.roof - 1] : map.row[map.roof - 1]) : ZZZ_BitCount(row_mask ^ map.row[0]) + ZZZ_BitCount(map.roof == map.height ? ~row_mask & map.row[map.roof - 1] : map.row[map.roof - 1]);
+    for (int y = 0; y < map.roof; ++y)
+    {
+        col += !map.full(0, y) + !map.full(width_m1, y) + ZZZ_BitCount((map.row[y] ^ (map.row[y] << 1)) & col_mask);
+        if (y != 0)
+        {
+            row += ZZZ_BitCount(map.row[y - 1] ^ map.row[y]);
+        }
+    }
+}
+
+//随机垃圾行上随便放几块,再把每种块的每个落点都放一遍
+std::vector<Sample> make_sample(m_tetris::TetrisContext const *context, size_t count, unsigned seed)
+{
+    std::mt19937 r(seed);
+    std::vector<Sample> sample;
+    while (sample.size() < count)
+    {
+        m_tetris::TetrisMap src_map(context->width(), context->height());
+        int garbage = r() % 8;
+        for (int y = 0; y < garbage; ++y)
+        {
+            int hole = r() % context->width();
+            for (int x = 0; x < context->width(); ++x)
+            {
+                if (x != hole)
+                {
+                    src_map.top[x] = src_map.roof = y + 1;
+                    src_map.row[y] |= 1 << x;
+                    ++src_map.count;
+                }
+            }
+        }
+        src_map.rehash();
+        for (int i = r() % 12; i > 0; --i)
+        {
+            m_tetris::TetrisNode const *node = context->generate(r() % context->type_max());
+            for (int move = r() % 8; move > 0; --move)
+            {
+                m_tetris::TetrisNode const *next = (move & 1 ? node->move_left : node->move_right).get();
+                node = next != nullptr && next->check(src_map) ? next : node;
+            }
+            if (node->check(src_map))
+            {
+                node->drop(src_map)->attach(src_map);
+            }
+        }
+        if (src_map.roof == 0 || src_map.roof > 16)
+        {
+            continue;
+        }
+        for (size_t t = 0; t < context->type_max(); ++t)
+        {
+            for (m_tetris::TetrisNode const *node = context->generate(t); node != nullptr; node = node->move_right.get())
+            {
+                if (!node->check(src_map))
+                {
+                    break;
+                }
+                Sample item = { node->drop(src_map), src_map, src_map, 0 };
+                item.clear = item.node->attach(item.map);
+                sample.push_back(item);
+            }
+        }
+    }
+    return sample;
+}
+
+template<class Func>
+void bench(char const *name, std::vector<Sample> const &sample, size_t round, Func func)
+{
+    double sink = 0;
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < round; ++i)
+    {
+        for (auto &item : sample)
+        {
+            sink += func(item);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - begin).count() / (round * sample.size());
+    std::cout << name << " ns_per_eval=" << ns << " eval_per_s=" << 1e9 / ns << " sink=" << sink << std::endl;
+}
+
+//eval的结果逐个取位模式做FNV-1a,和expect对照
+template<class Func>
+void check(char const *name, std::vector<Sample> const &sample, uint64_t expect, Func func)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto &item : sample)
+    {
+        double value = func(item);
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        for (int i = 0; i < 64; i += 8)
+        {
+            hash = (hash ^ ((bits >> i) & 0xff)) * 1099511628211ULL;
+        }
+    }
+    std::cout << name << " eval_hash=" << std::hex << hash << std::dec << " eval_mismatch=" << (hash != expect) << std::endl;
+}
+
+//各个AI改用TetrisFeature之前,在make_sample(context, 20000, 1)上用下面的配置算出来的eval哈希
+//改动不该影响eval结果的时候拿来对照,有意改了eval的时候要重新记
+uint64_t const toj_hash = 0xd8e49916c0b4238dULL;
+uint64_t const toj_v08_hash = 0xfde2b641076c7317ULL;
+uint64_t const dig_hash = 0x486775d70bd2e618ULL;
+uint64_t const c2_hash = 0x4ba5de6fe812a04eULL;
+uint64_t const attack_hash = 0x64c1b4ffba59fbdaULL;
+uint64_t const ax_hash = 0xeeb2389fbe9023bcULL;
+uint64_t const tag_old_hash = 0x91b8c43a50bb0cafULL;
+uint64_t const tag_hash = 0xffb10124ae55545bULL;
+
+//用法: feature_test [样本数] [轮数]
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? atoi(argv[1]) : 20000;
+    size_t round = argc > 2 ? atoi(argv[2]) : 20;
+    engine_t engine;
+    engine.prepare(10, 40);
+    m_tetris::TetrisContext const *context = engine.context().get();
+    std::vector<Sample> sample = make_sample(context, count, 1);
+    std::vector<Sample> check_sample = make_sample(context, 20000, 1);
+
+    m_tetris::TetrisFeature feature;
+    feature.init(context);
+    size_t mismatch = 0;
+    for (auto &item : sample)
+    {
+        for (int wall = 0; wall < 2; ++wall)
+        {
+            int col, row;
+            trans_ref(item.map, feature.col_mask(), feature.row_mask(), wall != 0, col, row);
+            m_tetris::TetrisFeature::Trans trans = wall ? feature.trans_wall(item.map) : feature.trans(item.map);
+            mismatch += trans.col != col || trans.row != row;
+        }
+    }
+    std::cout << "sample=" << sample.size() << " round=" << round << " trans_mismatch=" << mismatch << std::endl;
+    bench("trans_ref", sample, round, [&](Sample const &item)
+    {
+        int col, row;
+        trans_ref(item.map, feature.col_mask(), feature.row_mask(), true, col, row);
+        return double(col + row);
+    });
+    bench("trans_shared", sample, round, [&](Sample const &item)
+    {
+        m_tetris::TetrisFeature::Trans trans = feature.trans_wall(item.map);
+        return double(trans.col + trans.row);
+    });
+
+    //TOJ和C2的参数同ai.cpp,the_ai_games的同the_ai_games.cpp
+    ai_zzz::TOJ toj;
+    ai_zzz::TOJ::Config toj_config = {};
+    toj_config.table = combo_table;
+    toj_config.table_max = 13;
+    toj_config.param = { 35.129639875, 192.069159880, 187.666077972, 168.638556413, 269.647979472, 251.823560445, 3.983652369, -60.643482616, -34.508550264, 13.631881986, 1.393661859, 124.401318807, 154.665682713, 0.112408482, 0.002920693, -21.421748803, -5.167344137, -57.354678312, -69.579822364, -63.210184376, -1.480905918, 1.995795353, 0.105538942, -4.240213054, 5.630330647, 4.823540494, 3.562816454, 85.839825262, 0.005103939 };
+    toj.init(context, &toj_config);
+    auto toj_eval = [&](Sample const &item)
+    {
+        return toj.eval(item.node, item.map, item.src_map, item.clear).value;
+    };
+    ai_zzz::TOJ_v08 toj_v08;
+    ai_zzz::TOJ_v08::Config toj_v08_config = { combo_table, 13 };
+    toj_v08.init(context, &toj_v08_config);
+    auto toj_v08_eval = [&](Sample const &item)
+    {
+        return toj_v08.eval(item.node, item.map, item.src_map, item.clear).value;
+    };
+    ai_zzz::Dig dig;
+    ai_zzz::Dig::Config dig_config;
+    dig.init(context, &dig_config);
+    auto dig_eval = [&](Sample const &item)
+    {
+        return dig.eval(item.node, item.map, item.src_map, item.clear);
+    };
+    ai_zzz::C2 c2;
+    ai_zzz::C2::Config c2_config = {};
+    c2_config.p =
+    {
+        2.87224, 0.372169, 0.102604, 0.723501, 3.08721, 0.802789, -0.786174, 107.713, -0.540719, 109.116, -3.84305, 116.58, -1.00066, 49.7899, -1.23986, 391.808, -4.30493, 91.0623, -1.60608, 67.7934, 2.36365, 46016.9, 34.2515, 0.285739,
+    };
+    c2_config.p_rate = 1;
+    c2.init(context, &c2_config);
+    auto c2_eval = [&](Sample const &item)
+    {
+        return c2.eval(item.node, item.map, item.src_map, item.clear).map;
+    };
+    ai_zzz::qq::Attack attack;
+    ai_zzz::qq::Attack::Config attack_config = {};
+    attack.init(context, &attack_config);
+    auto attack_eval = [&](Sample const &item)
+    {
+        return attack.eval(item.node, item.map, item.src_map, item.clear).map;
+    };
+    ai_ax::AI ax;
+    ax.init(context);
+    auto ax_eval = [&](Sample const &item)
+    {
+        return ax.eval(item.node, item.map, item.src_map, item.clear).map;
+    };
+    ai_tag::the_ai_games_old tag_old;
+    tag_old.init(context);
+    auto tag_old_eval = [&](Sample const &item)
+    {
+        return tag_old.eval(item.node, item.map, item.src_map, item.clear).map;
+    };
+    ai_tag::the_ai_games tag;
+    ai_tag::the_ai_games::Config tag_config =
+    {
+        /*map_low_width       = */128.000000 ,
+        /*col_trans_width     = */170.000000 ,
+        /*row_trans_width     = */128.000000 ,
+        /*hold_count_width    = */80.000000  ,
+        /*hold_focus_width    = */400.000000 ,
+        /*well_depth_width    = */100.000000 ,
+        /*hole_depth_width    = */40.000000  ,
+        /*dig_clear_width     = */36.000000  ,
+        /*line_clear_width    = */80.000000  ,
+        /*tspin_clear_width   = */800.000000 ,
+        /*tetris_clear_width  = */4096.000000,
+        /*tspin_build_width   = */2.400000   ,
+        /*combo_add_width     = */56.000000  ,
+        /*combo_break_minute  = */64.000000  ,
+    };
+    tag.init(context, &tag_config);
+    auto tag_eval = [&](Sample const &item)
+    {
+        return tag.eval(item.node, item.map, item.src_map, item.clear).map;
+    };
+
+    check("ai_zzz::TOJ", check_sample, toj_hash, toj_eval);
+    check("ai_zzz::TOJ_v08", check_sample, toj_v08_hash, toj_v08_eval);
+    check("ai_zzz::Dig", check_sample, dig_hash, dig_eval);
+    check("ai_zzz::C2", check_sample, c2_hash, c2_eval);
+    check("ai_zzz::qq::Attack", check_sample, attack_hash, attack_eval);
+    check("ai_ax::AI", check_sample, ax_hash, ax_eval);
+    check("ai_tag::the_ai_games_old", check_sample, tag_old_hash, tag_old_eval);
+    check("ai_tag::the_ai_games", check_sample, tag_hash, tag_eval);
+
+    bench("ai_zzz::TOJ", sample, round, toj_eval);
+    bench("ai_zzz::TOJ_v08", sample, round, toj_v08_eval);
+    bench("ai_zzz::Dig", sample, round, dig_eval);
+    bench("ai_zzz::C2", sample, round, c2_eval);
+    bench("ai_zzz::qq::Attack", sample, round, attack_eval);
+    bench("ai_ax::AI", sample, round, ax_eval);
+    bench("ai_tag::the_ai_games_old", sample, round, tag_old_eval);
+    bench("ai_tag::the_ai_games", sample, round, tag_eval);
+}
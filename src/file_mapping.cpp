@@ -0,0 +1,110 @@
+﻿
+#include <cstdint>
+#include "file_mapping.h"
+#if _WIN32
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace zzz
+{
+#if _WIN32
+    FileMapping::FileMapping() : data_(), size_(), file_(INVALID_HANDLE_VALUE), mapping_()
+    {
+    }
+#else
+    FileMapping::FileMapping() : data_(), size_()
+    {
+    }
+#endif
+
+    FileMapping::~FileMapping()
+    {
+        close();
+    }
+
+    bool FileMapping::open(char const *path)
+    {
+        close();
+#if _WIN32
+        file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file_ == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file_, &size) || size.QuadPart == 0 || uint64_t(size.QuadPart) > SIZE_MAX)
+        {
+            close();
+            return false;
+        }
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping_ == nullptr)
+        {
+            close();
+            return false;
+        }
+        data_ = static_cast<char const *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        if(data_ == nullptr)
+        {
+            close();
+            return false;
+        }
+        size_ = size_t(size.QuadPart);
+        return true;
+#else
+        int file = ::open(path, O_RDONLY);
+        if(file < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if(fstat(file, &st) != 0 || st.st_size <= 0)
+        {
+            ::close(file);
+            return false;
+        }
+        void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, file, 0);
+        //映射建立后文件句柄就不需要了
+        ::close(file);
+        if(data == MAP_FAILED)
+        {
+            return false;
+        }
+        data_ = static_cast<char const *>(data);
+        size_ = size_t(st.st_size);
+        return true;
+#endif
+    }
+
+    void FileMapping::close()
+    {
+#if _WIN32
+        if(data_ != nullptr)
+        {
+            UnmapViewOfFile(data_);
+        }
+        if(mapping_ != nullptr)
+        {
+            CloseHandle(mapping_);
+        }
+        if(file_ != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file_);
+        }
+        file_ = INVALID_HANDLE_VALUE;
+        mapping_ = nullptr;
+#else
+        if(data_ != nullptr)
+        {
+            munmap(const_cast<char *>(data_), size_);
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
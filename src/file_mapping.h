@@ -0,0 +1,36 @@
+﻿
+#pragma once
+
+#include <cstddef>
+
+namespace zzz
+{
+    //只读文件映射
+    class FileMapping
+    {
+    public:
+        FileMapping();
+        ~FileMapping();
+        FileMapping(FileMapping const &) = delete;
+        FileMapping &operator = (FileMapping const &) = delete;
+
+        bool open(char const *path);
+        void close();
+        char const *data() const
+        {
+            return data_;
+        }
+        size_t size() const
+        {
+            return size_;
+        }
+
+    private:
+        char const *data_;
+        size_t size_;
+#if _WIN32
+        void *file_;
+        void *mapping_;
+#endif
+    };
+}
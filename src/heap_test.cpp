@@ -0,0 +1,167 @@
+#include "dary_heap.h"
+
+#include <algorithm>
+#include <cassert>
+#include <ctime>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <vector>
+
+struct Node
+{
+    char pad[192];
+    double value;
+};
+
+struct NodeCompare
+{
+    bool operator()(Node *left, Node *right) const
+    {
+        return left->value < right->value;
+    }
+};
+
+struct NodeKeyOf
+{
+    double operator()(Node *node) const
+    {
+        return node->value;
+    }
+};
+
+typedef std::priority_queue<Node *, std::vector<Node *>, NodeCompare> std_heap_t;
+typedef zzz::dary_heap<Node *, NodeKeyOf, 2> binary_heap_t;
+typedef zzz::dary_heap<Node *, NodeKeyOf, 4> quad_heap_t;
+
+template<class heap_t>
+void check(std::vector<Node *> const &data)
+{
+    heap_t heap;
+    std::vector<double> sorted;
+    for(auto n : data)
+    {
+        heap.push(n);
+        sorted.push_back(n->value);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    assert(heap.size() == data.size());
+    while(!heap.empty())
+    {
+        assert(heap.top()->value == sorted.back());
+        sorted.pop_back();
+        heap.pop();
+    }
+    heap.push(data.begin(), data.begin() + data.size() / 4);
+    heap.push(data.begin() + data.size() / 4, data.end());
+    for(auto n : data)
+    {
+        sorted.push_back(n->value);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    while(!heap.empty())
+    {
+        assert(heap.top()->value == sorted.back());
+        sorted.pop_back();
+        heap.pop();
+    }
+}
+
+//和搜索树一样:每次弹出一个,放进一组子节点
+template<class heap_t>
+clock_t run(std::vector<Node *> const &data, size_t children)
+{
+    clock_t t = clock();
+    heap_t heap;
+    size_t i = 0;
+    for(; i < children; ++i)
+    {
+        heap.push(data[i]);
+    }
+    double sum = 0;
+    while(!heap.empty())
+    {
+        sum += heap.top()->value;
+        heap.pop();
+        for(size_t j = 0; j < children && i < data.size(); ++j, ++i)
+        {
+            heap.push(data[i]);
+        }
+    }
+    t = clock() - t;
+    if(sum == 0)
+    {
+        std::cout << sum;
+    }
+    return t;
+}
+
+template<class heap_t>
+clock_t run_bulk(std::vector<Node *> const &data, size_t children)
+{
+    clock_t t = clock();
+    heap_t heap;
+    heap.push(data.begin(), data.begin() + children);
+    size_t i = children;
+    double sum = 0;
+    while(!heap.empty())
+    {
+        sum += heap.top()->value;
+        heap.pop();
+        size_t count = std::min(children, data.size() - i);
+        heap.push(data.begin() + i, data.begin() + i + count);
+        i += count;
+    }
+    t = clock() - t;
+    if(sum == 0)
+    {
+        std::cout << sum;
+    }
+    return t;
+}
+
+int main()
+{
+    std::mt19937 r;
+    std::vector<Node *> data;
+    int length = 10000;
+    for(int i = 0; i < length; ++i)
+    {
+        Node *n = new Node;
+        n->value = r() % 1000;
+        data.push_back(n);
+    }
+    check<binary_heap_t>(data);
+    check<quad_heap_t>(data);
+    for(auto n : data)
+    {
+        delete n;
+    }
+    data.clear();
+
+    length = 4000000;
+    std::cout << "count = " << length << std::endl;
+    for(int i = 0; i < length; ++i)
+    {
+        Node *n = new Node;
+        n->value = r() / double(r() + 1.0);
+        data.push_back(n);
+    }
+    for(size_t i = data.size() - 1; i > 0; --i)
+    {
+        std::swap(data[i], data[r() % (i + 1)]);
+    }
+    for(size_t children : { 1, 8, 32 })
+    {
+        std::cout << "children = " << children << std::endl;
+        std::cout << "priority_queue " << run<std_heap_t>(data, children) << std::endl;
+        std::cout << "binary heap    " << run<binary_heap_t>(data, children) << std::endl;
+        std::cout << "4-ary heap     " << run<quad_heap_t>(data, children) << std::endl;
+        std::cout << "4-ary bulk     " << run_bulk<quad_heap_t>(data, children) << std::endl;
+    }
+    for(auto n : data)
+    {
+        delete n;
+    }
+    data.clear();
+}
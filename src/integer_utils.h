@@ -7,6 +7,9 @@
 #if __SSE4_2__
 #   include <nmmintrin.h>
 #endif
+#if _MSC_VER
+#   include <intrin.h>
+#endif
 
 #if __SSE4_2__
 #   define ZZZ_BitCount(n) size_t(_mm_popcnt_u32(n))
@@ -14,8 +17,25 @@
 #   define ZZZ_BitCount(n) ::zzz::BitCountImpl(n)
 #endif
 
+//n不能为0
+#if __GNUC__
+#   define ZZZ_TrailingZeros(n) size_t(__builtin_ctz(n))
+#elif _MSC_VER
+#   define ZZZ_TrailingZeros(n) ::zzz::TrailingZerosMSVC(n)
+#else
+#   define ZZZ_TrailingZeros(n) ::zzz::NumberOfTrailingZeros(n)
+#endif
+
 namespace zzz
 {
     size_t BitCountImpl(uint32_t n);
     size_t NumberOfTrailingZeros(uint32_t i);
+#if _MSC_VER && !__GNUC__
+    inline size_t TrailingZerosMSVC(uint32_t n)
+    {
+        unsigned long index;
+        _BitScanForward(&index, n);
+        return index;
+    }
+#endif
 }
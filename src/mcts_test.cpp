@@ -0,0 +1,155 @@
+﻿#include "tetris_core.h"
+#include "tetris_mcts.h"
+#include "search_tspin.h"
+#include "ai_zzz.h"
+#include "rule_srs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <string>
+
+typedef m_tetris::TetrisEngine<rule_srs::TetrisRule, ai_zzz::TOJ, search_tspin::Search> tree_engine_t;
+typedef m_tetris::TetrisMCTSEngine<rule_srs::TetrisRule, ai_zzz::TOJ, search_tspin::Search> mcts_engine_t;
+
+int const combo_table[] = { 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 4, 5 };
+
+struct Score
+{
+    size_t move;
+    size_t clear;
+    size_t attack;
+    double cpu;
+};
+
+template<class engine_t>
+void config(engine_t &ai)
+{
+    ai.prepare(10, 40);
+    ai.search_config()->allow_rotate_move = false;
+    ai.search_config()->allow_180 = false;
+    ai.search_config()->allow_d = true;
+    ai.search_config()->is_20g = false;
+    ai.search_config()->last_rotate = false;
+    ai.ai_config()->table = combo_table;
+    ai.ai_config()->table_max = 13;
+    ai.ai_config()->param = { 35.129639875, 192.069159880, 187.666077972, 168.638556413, 269.647979472, 251.823560445, 3.983652369, -60.643482616, -34.508550264, 13.631881986, 1.393661859, 124.401318807, 154.665682713, 0.112408482, 0.002920693, -21.421748803, -5.167344137, -57.354678312, -69.579822364, -63.210184376, -1.480905918, 1.995795353, 0.105538942, -4.240213054, 5.630330647, 4.823540494, 3.562816454, 85.839825262, 0.005103939 };
+}
+
+//同样的7-bag序列放moves块,unknown>0时预览最后几个换成'?'
+template<class engine_t>
+Score play(engine_t &ai, unsigned seed, size_t moves, size_t preview, size_t unknown, time_t limit)
+{
+    std::mt19937 r(seed);
+    std::string next;
+    m_tetris::TetrisMap map(10, 40);
+    char hold = ' ';
+    int combo = 0;
+    bool b2b = false;
+    Score score = {};
+    clock_t cpu = clock();
+    for(; score.move < moves; ++score.move)
+    {
+        while(next.size() < preview + 2)
+        {
+            std::string bag = "IJLOSTZ";
+            std::shuffle(bag.begin(), bag.end(), r);
+            next += bag;
+        }
+        ai.update();
+        ai.ai_config()->safe = ai.ai()->get_safe(map);
+        auto status = ai.status();
+        status->death = 0;
+        status->combo = combo;
+        status->under_attack = 0;
+        status->map_rise = 0;
+        status->b2b = b2b;
+        status->acc_value = 0;
+        status->like = 0;
+        status->value = 0;
+        ai_zzz::TOJ::Status::init_t_value(map, status->t2_value, status->t3_value);
+        char cur = next[0];
+        m_tetris::TetrisNode const *node = ai.context()->generate(cur);
+        if(!node->check(map))
+        {
+            break;
+        }
+        std::string view = next.substr(1, preview);
+        std::fill(view.end() - std::min(unknown, view.size()), view.end(), '?');
+        auto result = ai.run_hold(map, node, hold, true, view.c_str(), view.size(), limit);
+        next.erase(next.begin());
+        if(result.change_hold && result.target == nullptr)
+        {
+            hold = cur;
+            continue;
+        }
+        if(result.change_hold)
+        {
+            if(hold == ' ')
+            {
+                next.erase(next.begin());
+            }
+            hold = cur;
+        }
+        if(result.target == nullptr)
+        {
+            break;
+        }
+        size_t clear = result.target->attach(map);
+        bool tspin = clear > 0 && result.target.type != search_tspin::Search::None;
+        size_t attack = 0;
+        if(clear > 0)
+        {
+            size_t base[] = { 0, 0, 1, 2, 4 };
+            attack = tspin ? (result.target.type == search_tspin::Search::TSpinMini ? 1 : clear * 2) : base[clear];
+            bool special = tspin || clear == 4;
+            attack += (special && b2b) + combo_table[std::min(12, combo + 1)];
+            b2b = special;
+            ++combo;
+        }
+        else
+        {
+            combo = 0;
+        }
+        score.clear += clear;
+        score.attack += attack;
+    }
+    score.cpu = double(clock() - cpu) * 1000 / CLOCKS_PER_SEC;
+    return score;
+}
+
+void print(char const *name, Score const &score, size_t simulation = 0)
+{
+    std::cout << name << " move=" << score.move << " clear=" << score.clear << " attack=" << score.attack << " cpu_ms=" << score.cpu << " attack_per_cpu_s=" << score.attack * 1000 / std::max(score.cpu, 1.0);
+    if(simulation != 0)
+    {
+        std::cout << " simulation=" << simulation;
+    }
+    std::cout << std::endl;
+}
+
+//用法: mcts_test [每步毫秒] [块数] [线程数] [预览数] [预览末尾'?'的个数]
+int main(int argc, char **argv)
+{
+    time_t limit = argc > 1 ? atoi(argv[1]) : 20;
+    size_t moves = argc > 2 ? atoi(argv[2]) : 200;
+    size_t threads = argc > 3 ? atoi(argv[3]) : 1;
+    size_t preview = argc > 4 ? atoi(argv[4]) : 5;
+    size_t unknown = argc > 5 ? atoi(argv[5]) : 0;
+    std::cout << "limit=" << limit << "ms moves=" << moves << " threads=" << threads << " preview=" << preview << " unknown=" << unknown << std::endl;
+    for(unsigned seed = 1; seed <= 3; ++seed)
+    {
+        tree_engine_t tree;
+        config(tree);
+        tree.thread_count(threads);
+        print("tree", play(tree, seed, moves, preview, unknown, limit));
+        mcts_engine_t mcts;
+        config(mcts);
+        mcts.thread_count(threads);
+        Score score = play(mcts, seed, moves, preview, unknown, limit);
+        print("mcts", score, mcts.simulation_count());
+    }
+}
@@ -157,6 +157,8 @@ struct test_ai
         , combo_table(_combo_table)
         , combo_table_max(_combo_table_max)
     {
+        //ÿAIռ64MB
+        ai.memory_limit(size_t(64) << 20);
     }
 
     void init(pso_data const &data, pso_config const &config)
@@ -343,6 +345,7 @@ struct test_ai
                 }
             }
         }
+        map.rehash();
     }
     void under_attack(int line)
     {
@@ -603,7 +606,7 @@ int main(int argc, char const *argv[])
     int combo_table[] = { 0,0,0,1,1,2,2,3,3,4,4,4,5 };
     int combo_table_max = 13;
     m_tetris::TetrisEngine<rule_srs::TetrisRule, ai_zzz::TOJ, search_tspin::Search> global_ai;
-    global_ai.prepare(10, 40);
+    global_ai.prepare(10, 40, ".");
 
     for (size_t i = 1; i <= count; ++i)
     {
@@ -0,0 +1,615 @@
+﻿
+#include "search_bitboard.h"
+#include "integer_utils.h"
+
+using namespace m_tetris;
+
+namespace
+{
+    inline uint32_t shift(uint32_t row, int offset)
+    {
+        return offset >= 0 ? row << offset : row >> -offset;
+    }
+
+    //在一行内向左右扩展,直到被挡住
+    //向高位用加法的进位一次扩展到头,向低位逐格扩展
+    inline uint32_t fill_row(uint32_t row, uint32_t free)
+    {
+        if ((free & (free + (free & (0 - free)))) == 0)
+        {
+            //只有一段空位
+            return free;
+        }
+        row |= ((free + row) ^ free) & free;
+        uint32_t next;
+        while ((next = row | (row >> 1 & free)) != row)
+        {
+            row = next;
+        }
+        return row;
+    }
+
+    //只拷贝方块数据
+    inline TetrisNode copy_node(TetrisNode const *node)
+    {
+        TetrisNode copy = {};
+        copy.status = node->status;
+        std::memcpy(copy.data, node->data, sizeof copy.data);
+        std::memcpy(copy.top, node->top, sizeof copy.top);
+        std::memcpy(copy.bottom, node->bottom, sizeof copy.bottom);
+        copy.row = node->row;
+        copy.height = node->height;
+        copy.col = node->col;
+        copy.width = node->width;
+        return copy;
+    }
+}
+
+namespace search_bitboard
+{
+    void Search::init(TetrisContext const *context, Config const *config)
+    {
+        context_ = context;
+        config_ = config;
+        tspin_.init(context, config);
+        node_mark_filtered_.init(context->node_max());
+        //搜索用的行掩码在每次搜索结束时清零
+        std::memset(reach_, 0, sizeof reach_);
+        std::memset(rotated_, 0, sizeof rotated_);
+        std::memset(touch_, 0, sizeof touch_);
+        std::memset(next_, 0, sizeof next_);
+        std::memset(frontier_, 0, sizeof frontier_);
+        std::memset(land_, 0, sizeof land_);
+        type_data_.assign(context->type_max(), TypeData());
+        for (auto &data : type_data_)
+        {
+            data.enable = true;
+            data.dedup = true;
+        }
+        //有效位置和坐标换算
+        for (size_t i = 0; i < context->node_max(); ++i)
+        {
+            TetrisNode const *node = context->get_node(i);
+            TypeData &data = type_data_[context->convert(node->status.t)];
+            int r = node->status.r;
+            int col_offset = node->col - node->status.x, row_offset = node->row - node->status.y;
+            if (!data.exist[r])
+            {
+                data.exist[r] = true;
+                data.col_offset[r] = col_offset;
+                data.row_offset[r] = row_offset;
+            }
+            else if (data.col_offset[r] != col_offset || data.row_offset[r] != row_offset)
+            {
+                data.enable = false;
+            }
+            data.valid[r][node->row] |= 1U << node->col;
+            data.top[r] = std::max<int>(data.top[r], node->row);
+            TetrisNode const *&column = data.column[r][node->col];
+            if (column == nullptr || node->row > column->row)
+            {
+                column = node;
+                data.column_row[r][node->col] = node->row;
+            }
+        }
+        //形状相同的节点之间的偏移
+        std::vector<std::vector<TetrisNode const *>> same(context->node_max());
+        for (size_t i = 0; i < context->node_max(); ++i)
+        {
+            TetrisNode const *node = context->get_node(i);
+            same[node->index_filtered].push_back(node);
+        }
+        for (auto const &list : same)
+        {
+            for (TetrisNode const *from : list)
+            {
+                for (TetrisNode const *to : list)
+                {
+                    if (to->status.r > from->status.r || to == from)
+                    {
+                        continue;
+                    }
+                    TypeData &data = type_data_[context->convert(from->status.t)];
+                    Twin &twin = data.twin[from->status.r][to->status.r];
+                    int8_t col = int8_t(to->col - from->col), row = int8_t(to->row - from->row);
+                    if (to->status.r == from->status.r || (twin.exist && (twin.col != col || twin.row != row)))
+                    {
+                        data.dedup = false;
+                    }
+                    twin.exist = true;
+                    twin.col = col;
+                    twin.row = row;
+                }
+            }
+        }
+        //旋转的候选位置,和构建指针网时的踢墙表顺序一致
+        for (size_t t = 0; t < type_data_.size(); ++t)
+        {
+            TypeData &data = type_data_[t];
+            char type = context->convert(t);
+            for (int r = 0; r < 4; ++r)
+            {
+                if (!data.exist[r])
+                {
+                    continue;
+                }
+                TetrisOpertion op = context->get_opertion(type, r);
+                bool(*rotate[3])(TetrisNode &, TetrisContext const *) =
+                {
+                    op.rotate_clockwise, op.rotate_counterclockwise, op.rotate_opposite
+                };
+                TetrisWallKickOpertion const *wall_kick[3] =
+                {
+                    &op.wall_kick_clockwise, &op.wall_kick_counterclockwise, &op.wall_kick_opposite
+                };
+                for (int dir = 0; dir < 3; ++dir)
+                {
+                    if (rotate[dir] == nullptr)
+                    {
+                        continue;
+                    }
+                    std::vector<Kick> &kick = data.kick[r][dir];
+                    //不踢墙的旋转,找一个能转的位置求偏移
+                    for (int col = 0; col < 32 && kick.empty(); ++col)
+                    {
+                        TetrisNode const *column = data.column[r][col];
+                        for (int row = column == nullptr ? -1 : column->row; row >= 0 && kick.empty(); --row)
+                        {
+                            TetrisNode const *node = get_node_(data, r, row, col);
+                            TetrisNode copy = copy_node(node);
+                            if (rotate[dir](copy, context))
+                            {
+                                kick.push_back({int8_t(copy.col - node->col), int8_t(copy.row - node->row), uint8_t(copy.status.r)});
+                            }
+                        }
+                    }
+                    TetrisNode copy = copy_node(context->generate(t));
+                    rotate[dir](copy, context);
+                    int kick_r = copy.status.r;
+                    if (!data.exist[kick_r])
+                    {
+                        data.enable = wall_kick[dir]->length == 0 && data.enable;
+                        continue;
+                    }
+                    for (size_t i = 0; i < wall_kick[dir]->length; ++i)
+                    {
+                        auto const &n = wall_kick[dir]->data[i];
+                        kick.push_back({int8_t(n.x + data.col_offset[kick_r] - data.col_offset[r]), int8_t(n.y + data.row_offset[kick_r] - data.row_offset[r]), uint8_t(kick_r)});
+                    }
+                    for (auto const &k : kick)
+                    {
+                        if (k.col <= -32 || k.col >= 32)
+                        {
+                            data.enable = false;
+                        }
+                        data.kick_up = std::max<int>(data.kick_up, k.row);
+                    }
+                }
+            }
+        }
+        //每个节点的踢墙表都要和偏移算出来的一致
+        for (size_t i = 0; i < context->node_max(); ++i)
+        {
+            TetrisNode const *node = context->get_node(i);
+            TypeData &data = type_data_[context->convert(node->status.t)];
+            if (data.enable && !verify_(data, node))
+            {
+                data.enable = false;
+            }
+            int r = node->status.r;
+            for (int twin_r = 0; data.enable && data.dedup && twin_r < r; ++twin_r)
+            {
+                Twin const &twin = data.twin[r][twin_r];
+                int row = node->row + twin.row, col = node->col + twin.col;
+                if (twin.exist && row >= 0 && row < max_height && col >= 0 && col < 32 && ((data.valid[twin_r][row] >> col) & 1) != 0 && get_node_(data, twin_r, row, col)->index_filtered != node->index_filtered)
+                {
+                    data.dedup = false;
+                }
+            }
+        }
+    }
+
+    std::vector<char> Search::make_path(TetrisNode const *node, TetrisNodeWithTSpinType const &land_point, TetrisMap const &map)
+    {
+        return tspin_.make_path(node, land_point, map);
+    }
+
+    std::vector<Search::TetrisNodeWithTSpinType> const *Search::search(TetrisMap const &map, TetrisNode const *node, size_t depth)
+    {
+        TypeData const &data = type_data_[context_->convert(node->status.t)];
+        if (!data.enable)
+        {
+            return tspin_.search(map, node, depth);
+        }
+        land_point_cache_.clear();
+        if (!node->check(map))
+        {
+            return &land_point_cache_;
+        }
+        bool is_20g = config_->is_20g;
+        if (is_20g)
+        {
+            node = node->drop(map);
+        }
+        build_free_(data, map, node);
+        for (int r = 0; r < 4; ++r)
+        {
+            //20g下停住的位置不会高于roof,只需要看roof附近的行
+            limit_[r] = is_20g ? std::min(data.top[r], map.roof + data.kick_up) : data.top[r];
+            high_[r] = is_20g && data.exist[r] ? limit_[r] : -1;
+            new_low_[r] = max_height;
+            new_high_[r] = -1;
+        }
+        int r0 = node->status.r;
+        high_[r0] = std::max<int>(high_[r0], node->row);
+        //起点已经按场景检查过,T的快照会把伸出场景顶部的出生位置挡住,search_tspin也总是从起点开始
+        free_[r0][node->row] |= 1U << node->col;
+        if (is_20g)
+        {
+            fill_20g_(data, r0, node->row, node->col);
+        }
+        else
+        {
+            fill_(data, r0, node->row, node->col);
+        }
+        bool is_t = node->status.t == 'T';
+        if (!data.dedup)
+        {
+            node_mark_filtered_.clear();
+        }
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int y = 0; y <= high_[r]; ++y)
+            {
+                //不能再下落的就是落点
+                land_[r][y] = reach_[r][y] & (y == 0 ? ~0U : ~free_[r][y - 1]);
+            }
+        }
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int y = 0; y <= high_[r]; ++y)
+            {
+                uint32_t land = land_[r][y];
+                for (int twin_r = 0; data.dedup && twin_r < r; ++twin_r)
+                {
+                    //形状相同的位置只保留旋转状态最小的
+                    Twin const &twin = data.twin[r][twin_r];
+                    int twin_y = y + twin.row;
+                    if (twin.exist && twin_y >= 0 && twin_y <= high_[twin_r])
+                    {
+                        land &= ~shift(land_[twin_r][twin_y], -twin.col);
+                    }
+                }
+                while (land != 0)
+                {
+                    int x = ZZZ_TrailingZeros(land);
+                    land &= land - 1;
+                    TetrisNode const *land_node = get_node_(data, r, y, x);
+                    if (!data.dedup && !node_mark_filtered_.mark(land_node))
+                    {
+                        continue;
+                    }
+                    if (!is_t)
+                    {
+                        land_point_cache_.push_back(land_node);
+                        continue;
+                    }
+                    bool is_rotate = ((rotated_[r][y] >> x) & 1) != 0;
+                    //起点没有上一步,20g下只靠下落到达的也没有
+                    bool is_touch = land_node != node && (!is_20g || ((touch_[r][y] >> x) & 1) != 0);
+                    TetrisNodeWithTSpinType node_ex(land_node);
+                    node_ex.last = is_rotate ? find_last_(data, r, y, x) : nullptr;
+                    node_ex.is_check = true;
+                    node_ex.is_last_rotate = is_rotate || (!is_touch && depth == 0 && config_->last_rotate);
+                    node_ex.is_ready = tspin_.check_ready(map, land_node);
+                    node_ex.is_mini_ready = tspin_.check_mini_ready(snap_, node_ex);
+                    land_point_cache_.push_back(node_ex);
+                }
+            }
+        }
+        for (int r = 0; r < 4; ++r)
+        {
+            if (high_[r] >= 0)
+            {
+                size_t size = sizeof(uint32_t) * (high_[r] + 1);
+                std::memset(reach_[r], 0, size);
+                std::memset(rotated_[r], 0, size);
+                std::memset(touch_[r], 0, size);
+                std::memset(frontier_[r], 0, size);
+                std::memset(land_[r], 0, size);
+            }
+        }
+        return &land_point_cache_;
+    }
+
+    TetrisNode const *Search::get_node_(TypeData const &data, int r, int row, int col) const
+    {
+        return data.column[r][col] + (data.column_row[r][col] - row);
+    }
+
+    bool Search::verify_(TypeData const &data, TetrisNode const *node) const
+    {
+        int r = node->status.r;
+        if (get_node_(data, r, node->row, node->col) != node)
+        {
+            return false;
+        }
+        TetrisNodeList const *wall_kick[3] =
+        {
+            &node->wall_kick_clockwise, &node->wall_kick_counterclockwise, &node->wall_kick_opposite
+        };
+        for (int dir = 0; dir < 3; ++dir)
+        {
+            size_t index = 0;
+            for (auto const &k : data.kick[r][dir])
+            {
+                int row = node->row + k.row, col = node->col + k.col;
+                if (row < 0 || row >= max_height || col < 0 || col >= 32 || ((data.valid[k.r][row] >> col) & 1) == 0)
+                {
+                    continue;
+                }
+                if (index == wall_kick[dir]->size() || (*wall_kick[dir])[index] != get_node_(data, k.r, row, col))
+                {
+                    return false;
+                }
+                ++index;
+            }
+            if (index != wall_kick[dir]->size())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Search::build_free_(TypeData const &data, TetrisMap const &map, TetrisNode const *node)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            if (!data.exist[r])
+            {
+                continue;
+            }
+            uint32_t *row = drop_free_[r];
+            int top = data.top[r], low = std::min<int>(map.roof, top + 1);
+            std::memset(row, 0, sizeof(uint32_t) * low);
+            auto block = context_->get_block(node->status.t, r);
+            for (uint32_t i = 0; i < block->count; ++i)
+            {
+                int bx = block->data[i].x, by = block->data[i].y;
+                for (int y = 0, ey = std::min<int>(map.roof - by, low); y < ey; ++y)
+                {
+                    row[y] |= map.row[y + by] >> bx;
+                }
+            }
+            for (int y = 0; y < low; ++y)
+            {
+                row[y] = data.valid[r][y] & ~row[y];
+            }
+            //roof以上都是空的
+            std::memcpy(row + low, data.valid[r] + low, sizeof(uint32_t) * (top + 1 - low));
+        }
+        if (node->status.t != 'T')
+        {
+            free_ = drop_free_;
+            return;
+        }
+        //T的移动和旋转按快照检查,和search_tspin一致
+        std::memset(snap_.row, 0, sizeof snap_.row);
+        node->build_snap(map, context_, snap_);
+        for (int r = 0; r < 4; ++r)
+        {
+            if (data.exist[r])
+            {
+                for (int y = 0; y <= data.top[r]; ++y)
+                {
+                    snap_free_[r][y] = data.valid[r][y] & ~snap_.row[r][y];
+                }
+            }
+        }
+        free_ = snap_free_;
+    }
+
+    uint32_t Search::rotate_(TypeData const &data, int r, uint32_t const *from, uint32_t(*to)[max_height], int low, int high)
+    {
+        uint32_t dirty = 0;
+        int dir_max = config_->allow_180 ? 3 : 2;
+        for (int y = low; y <= high; ++y)
+        {
+            if (from[y] == 0)
+            {
+                continue;
+            }
+            for (int dir = 0; dir < dir_max; ++dir)
+            {
+                std::vector<Kick> const &kick = data.kick[r][dir];
+                //remain是还没找到位置的起点,按踢墙顺序逐个尝试
+                uint32_t remain = from[y];
+                for (auto it = kick.begin(); remain != 0 && it != kick.end(); ++it)
+                {
+                    int row = y + it->row;
+                    if (row < 0 || row > limit_[it->r])
+                    {
+                        continue;
+                    }
+                    uint32_t fit = shift(remain, it->col) & free_[it->r][row];
+                    if (fit != 0)
+                    {
+                        uint32_t add = fit & ~to[it->r][row];
+                        if (add != 0)
+                        {
+                            to[it->r][row] |= add;
+                            dirty |= 1U << it->r;
+                            high_[it->r] = std::max(high_[it->r], row);
+                            new_low_[it->r] = std::min(new_low_[it->r], row);
+                            new_high_[it->r] = std::max(new_high_[it->r], row);
+                        }
+                        //已经到过的位置也要记下能转过来,和search_tspin的cover_if一样
+                        rotated_[it->r][row] |= fit;
+                        remain &= ~shift(fit, -it->col);
+                    }
+                }
+            }
+        }
+        return dirty;
+    }
+
+    void Search::fill_(TypeData const &data, int r0, int row0, int col0)
+    {
+        reach_[r0][row0] = 1U << col0;
+        new_low_[r0] = new_high_[r0] = row0;
+        uint32_t dirty = 1U << r0;
+        uint32_t from[max_height];
+        while (dirty != 0)
+        {
+            int r = ZZZ_TrailingZeros(dirty);
+            dirty &= dirty - 1;
+            //只能左右和向下移动,从上往下扫一遍就能得到这个旋转状态的全部可达位置
+            //只需要从有新位置的最高行开始,过了最低的新位置之后某行不再变化就可以停了
+            uint32_t const *free = free_[r];
+            uint32_t *reach = reach_[r];
+            uint32_t *done = frontier_[r];
+            int high = new_high_[r], low = new_low_[r];
+            new_high_[r] = -1;
+            new_low_[r] = max_height;
+            uint32_t above = 0;
+            int y = high;
+            for (; y >= 0; --y)
+            {
+                uint32_t row = (reach[y] | above) & free[y];
+                if (row != 0)
+                {
+                    row = fill_row(row, free[y]);
+                }
+                if (y < low && row == done[y])
+                {
+                    break;
+                }
+                reach[y] = row;
+                above = row;
+                //已经旋转过的位置不用再转
+                from[y] = row & ~done[y];
+                done[y] = row;
+            }
+            dirty |= rotate_(data, r, from, reach_, y + 1, high);
+        }
+    }
+
+    void Search::fill_20g_(TypeData const &data, int r0, int row0, int col0)
+    {
+        reach_[r0][row0] = frontier_[r0][row0] = 1U << col0;
+        //frontier_是上一步新停住的位置,只处理它们所在的行
+        int front_low[4] = { max_height, max_height, max_height, max_height }, front_high[4] = { -1, -1, -1, -1 };
+        front_low[r0] = front_high[r0] = row0;
+        uint32_t active = 1U << r0;
+        while (active != 0)
+        {
+            for (uint32_t bits = active; bits != 0; bits &= bits - 1)
+            {
+                int r = ZZZ_TrailingZeros(bits);
+                for (int y = front_low[r]; y <= front_high[r]; ++y)
+                {
+                    uint32_t row = frontier_[r][y];
+                    uint32_t move = (row << 1 | row >> 1) & free_[r][y];
+                    if (move != 0)
+                    {
+                        next_[r][y] |= move;
+                        new_low_[r] = std::min(new_low_[r], y);
+                        new_high_[r] = std::max(new_high_[r], y);
+                    }
+                }
+                rotate_(data, r, frontier_[r], next_, front_low[r], front_high[r]);
+                for (int y = front_low[r]; y <= front_high[r]; ++y)
+                {
+                    frontier_[r][y] = 0;
+                }
+            }
+            active = 0;
+            for (int r = 0; r < 4; ++r)
+            {
+                int high = new_high_[r], low = new_low_[r];
+                front_low[r] = max_height;
+                front_high[r] = -1;
+                if (high < 0)
+                {
+                    continue;
+                }
+                new_low_[r] = max_height;
+                new_high_[r] = -1;
+                uint32_t *next = next_[r];
+                for (int y = low; y <= high; ++y)
+                {
+                    touch_[r][y] |= next[y];
+                }
+                //每一步之后都落到底
+                int bottom = high;
+                for (; bottom > 0; --bottom)
+                {
+                    if (next[bottom] == 0)
+                    {
+                        if (bottom <= low)
+                        {
+                            break;
+                        }
+                        continue;
+                    }
+                    uint32_t fall = next[bottom] & drop_free_[r][bottom - 1];
+                    next[bottom] &= ~fall;
+                    next[bottom - 1] |= fall;
+                }
+                for (int y = bottom; y <= high; ++y)
+                {
+                    uint32_t add = next[y] & ~reach_[r][y];
+                    next[y] = 0;
+                    if (add != 0)
+                    {
+                        frontier_[r][y] = add;
+                        reach_[r][y] |= add;
+                        front_low[r] = std::min(front_low[r], y);
+                        front_high[r] = std::max(front_high[r], y);
+                        active |= 1U << r;
+                    }
+                }
+            }
+        }
+    }
+
+    TetrisNode const *Search::find_last_(TypeData const &data, int r, int row, int col) const
+    {
+        //找一个旋转后第一个能放下的位置就是这里的起点
+        int dir_max = config_->allow_180 ? 3 : 2;
+        for (int from = 0; from < 4; ++from)
+        {
+            if (!data.exist[from])
+            {
+                continue;
+            }
+            for (int dir = 0; dir < dir_max; ++dir)
+            {
+                std::vector<Kick> const &kick = data.kick[from][dir];
+                for (auto const &k : kick)
+                {
+                    int y = row - k.row, x = col - k.col;
+                    if (k.r != r || y < 0 || y > data.top[from] || x < 0 || x >= 32 || ((reach_[from][y] >> x) & 1) == 0)
+                    {
+                        continue;
+                    }
+                    for (auto const &first : kick)
+                    {
+                        int fy = y + first.row, fx = x + first.col;
+                        if (fy < 0 || fy > data.top[first.r] || fx < 0 || fx >= 32 || ((free_[first.r][fy] >> fx) & 1) == 0)
+                        {
+                            continue;
+                        }
+                        if (first.r == r && fy == row && fx == col)
+                        {
+                            return get_node_(data, from, y, x);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        return nullptr;
+    }
+}
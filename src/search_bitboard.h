@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include "tetris_core.h"
+#include "search_tspin.h"
+#include <vector>
+#include <cstddef>
+
+namespace search_bitboard
+{
+    //位棋盘落点搜索
+    //每个旋转状态的可达位置用行掩码表示,左右下移动和旋转踢墙都是整行的移位和掩码运算
+    //落点集合和search_tspin一样,可以直接替换它做TetrisSearch,路径生成交给search_tspin
+    class Search
+    {
+    public:
+        typedef search_tspin::Search::TSpinType TSpinType;
+        typedef search_tspin::Search::Config Config;
+        typedef search_tspin::Search::TetrisNodeWithTSpinType TetrisNodeWithTSpinType;
+        void init(m_tetris::TetrisContext const *context, Config const *config);
+        std::vector<char> make_path(m_tetris::TetrisNode const *node, TetrisNodeWithTSpinType const &land_point, m_tetris::TetrisMap const &map);
+        std::vector<TetrisNodeWithTSpinType> const *search(m_tetris::TetrisMap const &map, m_tetris::TetrisNode const *node, size_t depth);
+    private:
+        //旋转后的位置偏移
+        struct Kick
+        {
+            int8_t col, row;
+            uint8_t r;
+        };
+        //同样形状的另一个旋转状态的位置偏移
+        struct Twin
+        {
+            bool exist;
+            int8_t col, row;
+        };
+        struct TypeData
+        {
+            //踢墙表能用统一的偏移表示,否则这种方块交给search_tspin
+            bool enable;
+            bool exist[4];
+            int col_offset[4], row_offset[4];
+            //最高的有效行
+            int top[4];
+            //踢墙最多向上的行数
+            int kick_up;
+            //每行有效位置的掩码
+            uint32_t valid[4][m_tetris::max_height];
+            //每列最高的节点和它的行,同一列的节点连续存放
+            m_tetris::TetrisNode const *column[4][32];
+            int column_row[4][32];
+            //形状相同的旋转状态能用统一的偏移对应上,就用掩码去重
+            bool dedup;
+            Twin twin[4][4];
+            //顺时针,逆时针,180°的候选位置,按踢墙顺序
+            std::vector<Kick> kick[4][3];
+        };
+        m_tetris::TetrisNode const *get_node_(TypeData const &data, int r, int row, int col) const;
+        bool verify_(TypeData const &data, m_tetris::TetrisNode const *node) const;
+        void build_free_(TypeData const &data, m_tetris::TetrisMap const &map, m_tetris::TetrisNode const *node);
+        //旋转到的新位置写入to,返回有新位置的旋转状态
+        uint32_t rotate_(TypeData const &data, int r, uint32_t const *from, uint32_t (*to)[m_tetris::max_height], int low, int high);
+        void fill_(TypeData const &data, int r0, int row0, int col0);
+        void fill_20g_(TypeData const &data, int r0, int row0, int col0);
+        m_tetris::TetrisNode const *find_last_(TypeData const &data, int r, int row, int col) const;
+        std::vector<TetrisNodeWithTSpinType> land_point_cache_;
+        std::vector<TypeData> type_data_;
+        m_tetris::TetrisNodeMarkFiltered node_mark_filtered_;
+        m_tetris::TetrisMapSnap snap_;
+        //按场景检查的空位(用于下落)和按快照检查的空位(用于移动,T用快照,其他方块相同)
+        uint32_t drop_free_[4][m_tetris::max_height];
+        uint32_t snap_free_[4][m_tetris::max_height];
+        uint32_t (*free_)[m_tetris::max_height];
+        //每个旋转状态允许的最高行和目前用到的最高行
+        int limit_[4];
+        int high_[4];
+        //还没有扫过的新位置所在的行范围
+        int new_low_[4];
+        int new_high_[4];
+        uint32_t reach_[4][m_tetris::max_height];
+        //旋转到达的位置(T的最后一步是否旋转),20g下还要记录移动到达的位置
+        uint32_t rotated_[4][m_tetris::max_height];
+        uint32_t touch_[4][m_tetris::max_height];
+        uint32_t next_[4][m_tetris::max_height];
+        uint32_t frontier_[4][m_tetris::max_height];
+        uint32_t land_[4][m_tetris::max_height];
+        search_tspin::Search tspin_;
+        Config const *config_;
+        m_tetris::TetrisContext const *context_;
+    };
+}
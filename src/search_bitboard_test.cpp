@@ -0,0 +1,269 @@
+﻿#include "tetris_core.h"
+#include "integer_utils.h"
+#include "search_tspin.h"
+#include "search_bitboard.h"
+#include "ai_zzz.h"
+#include "rule_srs.h"
+#include "rule_toj.h"
+#include "rule_st.h"
+#include "rule_qq.h"
+#include "rule_c2.h"
+#include "rule_tag.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+typedef search_tspin::Search::TetrisNodeWithTSpinType TetrisNodeWithTSpinType;
+
+//逐个节点广度优先的写法,用来确认search_tspin漏掉的落点确实能到
+//T和search_tspin一样按快照检查,其他方块按场景检查
+std::vector<char> reach_ref(m_tetris::TetrisContext const *context, m_tetris::TetrisMap const &map, m_tetris::TetrisNode const *node, bool is_20g, bool allow_180)
+{
+    std::vector<char> land(context->node_max());
+    if (!node->check(map))
+    {
+        return land;
+    }
+    bool is_t = node->status.t == 'T';
+    m_tetris::TetrisMapSnap snap;
+    node->build_snap(map, context, snap);
+    auto check = [&](m_tetris::TetrisNode const *n)
+    {
+        return is_t ? n->check(snap) : n->check(map);
+    };
+    auto kick = [&](m_tetris::TetrisNodeList const &list) -> m_tetris::TetrisNode const *
+    {
+        for (auto n : list)
+        {
+            if (check(n))
+            {
+                return n;
+            }
+        }
+        return nullptr;
+    };
+    std::vector<char> mark(context->node_max());
+    std::vector<m_tetris::TetrisNode const *> search;
+    search.push_back(is_20g ? node->drop(map) : node);
+    mark[search.front()->index] = 1;
+    for (size_t i = 0; i < search.size(); ++i)
+    {
+        node = is_20g ? search[i]->drop(map) : search[i];
+        if (!node->move_down || !check(node->move_down))
+        {
+            land[node->index_filtered] = 1;
+        }
+        m_tetris::TetrisNode const *next[] =
+        {
+            node->move_left, node->move_right, node->move_down, kick(node->wall_kick_clockwise), kick(node->wall_kick_counterclockwise), allow_180 ? kick(node->wall_kick_opposite) : nullptr
+        };
+        for (auto n : next)
+        {
+            if (n != nullptr && !mark[n->index] && check(n))
+            {
+                mark[n->index] = 1;
+                search.push_back(n);
+            }
+        }
+    }
+    return land;
+}
+
+//last旋转一次(第一个能放下的踢墙位置)要正好到node,T按快照检查
+bool check_last(m_tetris::TetrisContext const *context, m_tetris::TetrisMap const &map, TetrisNodeWithTSpinType const &node_ex)
+{
+    m_tetris::TetrisMapSnap snap;
+    node_ex->build_snap(map, context, snap);
+    for (m_tetris::TetrisNodeList const *list : { &node_ex.last->wall_kick_clockwise, &node_ex.last->wall_kick_counterclockwise, &node_ex.last->wall_kick_opposite })
+    {
+        for (auto n : *list)
+        {
+            if (n->check(snap))
+            {
+                if (n == node_ex.node)
+                {
+                    return true;
+                }
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+//改完row之后重新算top,roof,count和哈希
+void fix_map(m_tetris::TetrisMap &map)
+{
+    map.roof = 0;
+    map.count = 0;
+    for (int x = 0; x < map.width; ++x)
+    {
+        map.top[x] = 0;
+    }
+    for (int y = 0; y < map.height; ++y)
+    {
+        if (map.row[y] == 0)
+        {
+            continue;
+        }
+        map.roof = y + 1;
+        map.count += int(ZZZ_BitCount(map.row[y]));
+        for (int x = 0; x < map.width; ++x)
+        {
+            if (map.full(x, y))
+            {
+                map.top[x] = y + 1;
+            }
+        }
+    }
+    map.rehash();
+}
+
+//随机垃圾行上随便放几块,再挖掉几格做出悬空和T坑
+m_tetris::TetrisMap make_map(m_tetris::TetrisContext const *context, std::mt19937 &r)
+{
+    m_tetris::TetrisMap map(context->width(), context->height());
+    int garbage = r() % 8;
+    for (int y = 0; y < garbage; ++y)
+    {
+        map.row[y] = context->full() & ~(1U << (r() % context->width()));
+    }
+    fix_map(map);
+    for (int i = r() % 12; i > 0; --i)
+    {
+        m_tetris::TetrisNode const *node = context->generate(r() % context->type_max());
+        for (int move = r() % 8; move > 0; --move)
+        {
+            m_tetris::TetrisNode const *next = (move & 1 ? node->move_left : node->move_right).get();
+            node = next != nullptr && next->check(map) ? next : node;
+        }
+        if (!node->check(map))
+        {
+            break;
+        }
+        node->drop(map)->attach(map);
+    }
+    for (int i = r() % 8; i > 0 && map.roof > 0; --i)
+    {
+        map.row[r() % map.roof] &= ~(1U << (r() % context->width()));
+    }
+    fix_map(map);
+    return map;
+}
+
+//各种设置下落点集合和T的标记逐个场景和search_tspin对照
+//不是20g时search_tspin按快照剪枝会漏掉少数落点,多出来的要能被reach_ref走到
+template<class TetrisRule>
+void run(char const *rule_name, int width, int height, size_t count, size_t round)
+{
+    m_tetris::TetrisEngine<TetrisRule, ai_zzz::TOJ, search_tspin::Search> engine;
+    if (!engine.prepare(width, height))
+    {
+        std::cout << rule_name << " prepare failed" << std::endl;
+        return;
+    }
+    m_tetris::TetrisContext const *context = engine.context().get();
+    std::mt19937 r(1);
+    std::vector<m_tetris::TetrisMap> sample;
+    while (sample.size() < count)
+    {
+        sample.push_back(make_map(context, r));
+    }
+    for (int setting = 0; setting < 8; ++setting)
+    {
+        search_tspin::Search::Config config;
+        config.allow_180 = (setting & 1) != 0;
+        config.is_20g = (setting & 2) != 0;
+        config.last_rotate = (setting & 4) != 0;
+        //两边都一直复用同一个实例,上一次搜索留下的状态不能影响结果
+        search_tspin::Search tspin;
+        tspin.init(context, &config);
+        search_bitboard::Search bitboard;
+        bitboard.init(context, &config);
+        size_t land = 0, extra = 0, mismatch = 0, flag_mismatch = 0;
+        for (size_t depth = 0; depth < 2; ++depth)
+        {
+            for (auto &map : sample)
+            {
+                for (size_t i = 0; i < context->type_max(); ++i)
+                {
+                    m_tetris::TetrisNode const *node = context->generate(i);
+                    std::map<size_t, TetrisNodeWithTSpinType> expect, result;
+                    for (auto &node_ex : *tspin.search(map, node, depth))
+                    {
+                        expect.emplace(node_ex->index_filtered, node_ex);
+                    }
+                    for (auto &node_ex : *bitboard.search(map, node, depth))
+                    {
+                        mismatch += !result.emplace(node_ex->index_filtered, node_ex).second;
+                    }
+                    std::vector<char> ref = reach_ref(context, map, node, config.is_20g, config.allow_180);
+                    land += result.size();
+                    mismatch += size_t(std::count(ref.begin(), ref.end(), 1)) != result.size();
+                    for (auto &pair : result)
+                    {
+                        auto find = expect.find(pair.first);
+                        mismatch += ref[pair.first] == 0;
+                        if (find == expect.end())
+                        {
+                            extra += 1;
+                            mismatch += config.is_20g;
+                            continue;
+                        }
+                        TetrisNodeWithTSpinType const &a = find->second, &b = pair.second;
+                        if (node->status.t != 'T')
+                        {
+                            continue;
+                        }
+                        //last可以是不同的起点,但必须是真的转一次到这里
+                        if (a.is_check != b.is_check || a.is_last_rotate != b.is_last_rotate || a.is_ready != b.is_ready || a.is_mini_ready != b.is_mini_ready || (b.last != nullptr && !check_last(context, map, b)))
+                        {
+                            ++flag_mismatch;
+                        }
+                    }
+                    for (auto &pair : expect)
+                    {
+                        mismatch += result.count(pair.first) == 0;
+                    }
+                }
+            }
+        }
+        double best[2] = { 1e30, 1e30 };
+        long long sink = 0;
+        for (size_t i = 0; i < round; ++i)
+        {
+            for (int k = 0; k < 2; ++k)
+            {
+                auto begin = std::chrono::high_resolution_clock::now();
+                for (auto &map : sample)
+                {
+                    for (size_t j = 0; j < context->type_max(); ++j)
+                    {
+                        m_tetris::TetrisNode const *node = context->generate(j);
+                        sink += (k == 0 ? tspin.search(map, node, 0) : bitboard.search(map, node, 0))->size();
+                    }
+                }
+                best[k] = std::min(best[k], std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count());
+            }
+        }
+        std::cout << rule_name << " 180=" << config.allow_180 << " 20g=" << config.is_20g << " last_rotate=" << config.last_rotate << " land=" << land << " extra=" << extra << " mismatch=" << mismatch << " flag_mismatch=" << flag_mismatch << " tspin_ms=" << best[0] << " bitboard_ms=" << best[1] << " sink=" << sink << std::endl;
+    }
+}
+
+//用法: search_bitboard_test [每种规则的场景数] [轮数]
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? atoi(argv[1]) : 500;
+    size_t round = argc > 2 ? atoi(argv[2]) : 3;
+    run<rule_srs::TetrisRule>("rule_srs", 10, 40, count, round);
+    run<rule_toj::TetrisRule>("rule_toj", 10, 40, count, round);
+    run<rule_st::TetrisRule>("rule_st", 10, 21, count, round);
+    run<rule_qq::TetrisRule>("rule_qq", 12, 21, count, round);
+    run<rule_c2::TetrisRule>("rule_c2", 10, 21, count, round);
+    run<rule_tag::TetrisRule>("rule_tag", 10, 20, count, round);
+}
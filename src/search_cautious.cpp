@@ -230,81 +230,48 @@ namespace search_cautious
                     }
                 }
                 //x
-                for(TetrisNode const *wall_kick_node : node->wall_kick_opposite)
+                if(TetrisNode const *wall_kick_node = node->wall_kick_opposite.check_first(map))
                 {
-                    if(wall_kick_node)
+                    if(node_mark_.set(wall_kick_node, node, 'x'))
                     {
-                        if(wall_kick_node->check(map))
+                        if(wall_kick_node->index_filtered == index)
                         {
-                            if(node_mark_.set(wall_kick_node, node, 'x'))
-                            {
-                                if(wall_kick_node->index_filtered == index)
-                                {
-                                    return build_path(wall_kick_node, node_mark_);
-                                }
-                                else
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                            }
-                            break;
+                            return build_path(wall_kick_node, node_mark_);
+                        }
+                        else
+                        {
+                            node_search_.push_back(wall_kick_node);
                         }
-                    }
-                    else
-                    {
-                        break;
                     }
                 }
                 //z
-                for(TetrisNode const *wall_kick_node : node->wall_kick_counterclockwise)
+                if(TetrisNode const *wall_kick_node = node->wall_kick_counterclockwise.check_first(map))
                 {
-                    if(wall_kick_node)
+                    if(node_mark_.set(wall_kick_node, node, 'z'))
                     {
-                        if(wall_kick_node->check(map))
+                        if(wall_kick_node->index_filtered == index)
                         {
-                            if(node_mark_.set(wall_kick_node, node, 'z'))
-                            {
-                                if(wall_kick_node->index_filtered == index)
-                                {
-                                    return build_path(wall_kick_node, node_mark_);
-                                }
-                                else
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                            }
-                            break;
+                            return build_path(wall_kick_node, node_mark_);
+                        }
+                        else
+                        {
+                            node_search_.push_back(wall_kick_node);
                         }
-                    }
-                    else
-                    {
-                        break;
                     }
                 }
                 //c
-                for(TetrisNode const *wall_kick_node : node->wall_kick_clockwise)
+                if(TetrisNode const *wall_kick_node = node->wall_kick_clockwise.check_first(map))
                 {
-                    if(wall_kick_node)
+                    if(node_mark_.set(wall_kick_node, node, 'c'))
                     {
-                        if(wall_kick_node->check(map))
+                        if(wall_kick_node->index_filtered == index)
                         {
-                            if(node_mark_.set(wall_kick_node, node, 'c'))
-                            {
-                                if(wall_kick_node->index_filtered == index)
-                                {
-                                    return build_path(wall_kick_node, node_mark_);
-                                }
-                                else
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                            }
-                            break;
+                            return build_path(wall_kick_node, node_mark_);
+                        }
+                        else
+                        {
+                            node_search_.push_back(wall_kick_node);
                         }
-                    }
-                    else
-                    {
-                        break;
                     }
                 }
                 if(config_->fast_move_down)
@@ -383,60 +350,27 @@ namespace search_cautious
                     }
                 }
                 //x
-                for(TetrisNode const *wall_kick_node : node->wall_kick_opposite)
+                if(TetrisNode const *wall_kick_node = node->wall_kick_opposite.check_first(map))
                 {
-                    if(wall_kick_node)
+                    if(node_mark_.mark(wall_kick_node))
                     {
-                        if(wall_kick_node->check(map))
-                        {
-                            if(node_mark_.mark(wall_kick_node))
-                            {
-                                node_search_.push_back(wall_kick_node);
-                            }
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        break;
+                        node_search_.push_back(wall_kick_node);
                     }
                 }
                 //z
-                for(TetrisNode const *wall_kick_node : node->wall_kick_counterclockwise)
+                if(TetrisNode const *wall_kick_node = node->wall_kick_counterclockwise.check_first(map))
                 {
-                    if(wall_kick_node)
-                    {
-                        if(wall_kick_node->check(map))
-                        {
-                            if(node_mark_.mark(wall_kick_node))
-                            {
-                                node_search_.push_back(wall_kick_node);
-                            }
-                            break;
-                        }
-                    }
-                    else
+                    if(node_mark_.mark(wall_kick_node))
                     {
-                        break;
+                        node_search_.push_back(wall_kick_node);
                     }
                 }
                 //c
-                for(TetrisNode const *wall_kick_node : node->wall_kick_clockwise)
+                if(TetrisNode const *wall_kick_node = node->wall_kick_clockwise.check_first(map))
                 {
-                    if(wall_kick_node)
-                    {
-                        if(wall_kick_node->check(map))
-                        {
-                            if(node_mark_.mark(wall_kick_node))
-                            {
-                                node_search_.push_back(wall_kick_node);
-                            }
-                            break;
-                        }
-                    }
-                    else
+                    if(node_mark_.mark(wall_kick_node))
                     {
-                        break;
+                        node_search_.push_back(wall_kick_node);
                     }
                 }
                 //l
@@ -185,9 +185,9 @@ namespace search_path
         node_mark_.clear();
         node_mark_filtered_.clear();
         node_search_.clear();
-        if(node->land_point != nullptr && node->low >= map.roof)
+        if(!node->land_point.empty() && node->low >= map.roof)
         {
-            for(auto cit = node->land_point->begin(); cit != node->land_point->end(); ++cit)
+            for(auto cit = node->land_point.begin(); cit != node->land_point.end(); ++cit)
             {
                 TetrisNode const *drop_node = (*cit)->drop(map);
                 if(node_mark_filtered_.mark(drop_node))
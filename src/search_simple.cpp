@@ -70,9 +70,9 @@ namespace search_simple
             return &land_point_cache_;
         }
         node_mark_filtered_.clear();
-        if(node->land_point != nullptr && node->low >= map.roof)
+        if(!node->land_point.empty() && node->low >= map.roof)
         {
-            for(auto cit = node->land_point->begin(); cit != node->land_point->end(); ++cit)
+            for(auto cit = node->land_point.begin(); cit != node->land_point.end(); ++cit)
             {
                 push(node_mark_filtered_, land_point_cache_, (*cit)->drop(map));
             }
@@ -41,7 +41,7 @@ namespace search_simulate
         node_search_.push_back(node);
         node_mark_.set(node, nullptr, '\0');
         size_t cache_index = 0;
-        if(node->land_point != nullptr && node->low >= map.roof && land_point->open(map))
+        if(!node->land_point.empty() && node->low >= map.roof && land_point->open(map))
         {
             do
             {
@@ -302,9 +302,9 @@ namespace search_simulate
         node_mark_filtered_.clear();
         land_point_add_.clear();
         node_search_.clear();
-        if(node->land_point != nullptr && node->low >= map.roof)
+        if(!node->land_point.empty() && node->low >= map.roof)
         {
-            for(auto cit = node->land_point->begin(); cit != node->land_point->end(); ++cit)
+            for(auto cit = node->land_point.begin(); cit != node->land_point.end(); ++cit)
             {
                 TetrisNode const *land_point = (*cit)->drop(map);
                 if(node_mark_filtered_.mark(land_point))
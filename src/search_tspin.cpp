@@ -135,7 +135,7 @@ namespace search_tspin
             }
             return path;
         };
-        bool disable_d = land_point.type == None && node->land_point != nullptr && node->low >= map.roof && land_point->open(map);
+        bool disable_d = land_point.type == None && !node->land_point.empty() && node->low >= map.roof && land_point->open(map);
         while (true)
         {
             node_mark_.clear();
@@ -164,82 +164,49 @@ namespace search_tspin
                     //x
                     if (allow_180)
                     {
-                        for (TetrisNode const *wall_kick_node : node->wall_kick_opposite)
+                        if (TetrisNode const *wall_kick_node = node->wall_kick_opposite.check_first(map))
                         {
-                            if (wall_kick_node)
+                            if (node_mark_.set(wall_kick_node, node, 'x'))
                             {
-                                if (wall_kick_node->check(map))
+                                if (wall_kick_node->index_filtered == index)
                                 {
-                                    if (node_mark_.set(wall_kick_node, node, 'x'))
-                                    {
-                                        if (wall_kick_node->index_filtered == index)
-                                        {
-                                            return build_path(wall_kick_node, node_mark_);
-                                        }
-                                        else
-                                        {
-                                            node_search_.push_back(wall_kick_node);
-                                        }
-                                    }
-                                    break;
+                                    return build_path(wall_kick_node, node_mark_);
+                                }
+                                else
+                                {
+                                    node_search_.push_back(wall_kick_node);
                                 }
-                            }
-                            else
-                            {
-                                break;
                             }
                         }
                     }
                     //z
-                    for (TetrisNode const *wall_kick_node : node->wall_kick_counterclockwise)
+                    if (TetrisNode const *wall_kick_node = node->wall_kick_counterclockwise.check_first(map))
                     {
-                        if (wall_kick_node)
+                        if (node_mark_.set(wall_kick_node, node, 'z'))
                         {
-                            if (wall_kick_node->check(map))
+                            if (wall_kick_node->index_filtered == index)
                             {
-                                if (node_mark_.set(wall_kick_node, node, 'z'))
-                                {
-                                    if (wall_kick_node->index_filtered == index)
-                                    {
-                                        return build_path(wall_kick_node, node_mark_);
-                                    }
-                                    else
-                                    {
-                                        node_search_.push_back(wall_kick_node);
-                                    }
-                                }
-                                break;
+                                return build_path(wall_kick_node, node_mark_);
+                            }
+                            else
+                            {
+                                node_search_.push_back(wall_kick_node);
                             }
-                        }
-                        else
-                        {
-                            break;
                         }
                     }
                     //c
-                    for (TetrisNode const *wall_kick_node : node->wall_kick_clockwise)
+                    if (TetrisNode const *wall_kick_node = node->wall_kick_clockwise.check_first(map))
                     {
-                        if (wall_kick_node)
+                        if (node_mark_.set(wall_kick_node, node, 'c'))
                         {
-                            if (wall_kick_node->check(map))
+                            if (wall_kick_node->index_filtered == index)
                             {
-                                if (node_mark_.set(wall_kick_node, node, 'c'))
-                                {
-                                    if (wall_kick_node->index_filtered == index)
-                                    {
-                                        return build_path(wall_kick_node, node_mark_);
-                                    }
-                                    else
-                                    {
-                                        node_search_.push_back(wall_kick_node);
-                                    }
-                                }
-                                break;
+                                return build_path(wall_kick_node, node_mark_);
+                            }
+                            else
+                            {
+                                node_search_.push_back(wall_kick_node);
                             }
-                        }
-                        else
-                        {
-                            break;
                         }
                     }
                     //l
@@ -468,9 +435,9 @@ namespace search_tspin
         {
             return search_t(map, node, depth);
         }
-        if (!is_20g && node->land_point != nullptr && node->low >= map.roof)
+        if (!is_20g && !node->land_point.empty() && node->low >= map.roof)
         {
-            for (auto cit = node->land_point->begin(); cit != node->land_point->end(); ++cit)
+            for (auto cit = node->land_point.begin(); cit != node->land_point.end(); ++cit)
             {
                 TetrisNode const *drop_node = (*cit)->drop(map);
                 if (node_mark_filtered_.mark(drop_node))
@@ -523,61 +490,28 @@ namespace search_tspin
                     if (allow_180)
                     {
                         //x
-                        for (TetrisNode const *wall_kick_node : node->wall_kick_opposite)
+                        if (TetrisNode const *wall_kick_node = node->wall_kick_opposite.check_first(map))
                         {
-                            if (wall_kick_node)
+                            if (node_mark_.mark(wall_kick_node) && !wall_kick_node->open(map))
                             {
-                                if (wall_kick_node->check(map))
-                                {
-                                    if (node_mark_.mark(wall_kick_node) && !wall_kick_node->open(map))
-                                    {
-                                        node_search_.push_back(wall_kick_node);
-                                    }
-                                    break;
-                                }
-                            }
-                            else
-                            {
-                                break;
+                                node_search_.push_back(wall_kick_node);
                             }
                         }
                     }
                     //z
-                    for (TetrisNode const *wall_kick_node : node->wall_kick_counterclockwise)
+                    if (TetrisNode const *wall_kick_node = node->wall_kick_counterclockwise.check_first(map))
                     {
-                        if (wall_kick_node)
-                        {
-                            if (wall_kick_node->check(map))
-                            {
-                                if (node_mark_.mark(wall_kick_node) && !wall_kick_node->open(map))
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                                break;
-                            }
-                        }
-                        else
+                        if (node_mark_.mark(wall_kick_node) && !wall_kick_node->open(map))
                         {
-                            break;
+                            node_search_.push_back(wall_kick_node);
                         }
                     }
                     //c
-                    for (TetrisNode const *wall_kick_node : node->wall_kick_clockwise)
+                    if (TetrisNode const *wall_kick_node = node->wall_kick_clockwise.check_first(map))
                     {
-                        if (wall_kick_node)
-                        {
-                            if (wall_kick_node->check(map))
-                            {
-                                if (node_mark_.mark(wall_kick_node) && !wall_kick_node->open(map))
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                                break;
-                            }
-                        }
-                        else
+                        if (node_mark_.mark(wall_kick_node) && !wall_kick_node->open(map))
                         {
-                            break;
+                            node_search_.push_back(wall_kick_node);
                         }
                     }
                     //l
@@ -622,61 +556,28 @@ namespace search_tspin
                     if (allow_180)
                     {
                         //x
-                        for (TetrisNode const *wall_kick_node : node->wall_kick_opposite)
+                        if (TetrisNode const *wall_kick_node = node->wall_kick_opposite.check_first(map))
                         {
-                            if (wall_kick_node)
+                            if (node_mark_.mark(wall_kick_node))
                             {
-                                if (wall_kick_node->check(map))
-                                {
-                                    if (node_mark_.mark(wall_kick_node))
-                                    {
-                                        node_search_.push_back(wall_kick_node);
-                                    }
-                                    break;
-                                }
-                            }
-                            else
-                            {
-                                break;
+                                node_search_.push_back(wall_kick_node);
                             }
                         }
                     }
                     //z
-                    for (TetrisNode const *wall_kick_node : node->wall_kick_counterclockwise)
+                    if (TetrisNode const *wall_kick_node = node->wall_kick_counterclockwise.check_first(map))
                     {
-                        if (wall_kick_node)
+                        if (node_mark_.mark(wall_kick_node))
                         {
-                            if (wall_kick_node->check(map))
-                            {
-                                if (node_mark_.mark(wall_kick_node))
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                                break;
-                            }
-                        }
-                        else
-                        {
-                            break;
+                            node_search_.push_back(wall_kick_node);
                         }
                     }
                     //c
-                    for (TetrisNode const *wall_kick_node : node->wall_kick_clockwise)
+                    if (TetrisNode const *wall_kick_node = node->wall_kick_clockwise.check_first(map))
                     {
-                        if (wall_kick_node)
+                        if (node_mark_.mark(wall_kick_node))
                         {
-                            if (wall_kick_node->check(map))
-                            {
-                                if (node_mark_.mark(wall_kick_node))
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                                break;
-                            }
-                        }
-                        else
-                        {
-                            break;
+                            node_search_.push_back(wall_kick_node);
                         }
                     }
                     //l
@@ -814,85 +715,52 @@ namespace search_tspin
                 //x
                 if (allow_180)
                 {
-                    for (TetrisNode const *wall_kick_node : node->wall_kick_opposite)
+                    if (TetrisNode const *wall_kick_node = node->wall_kick_opposite.check_first(map))
                     {
-                        if (wall_kick_node)
+                        wall_kick_node = wall_kick_node->drop(map);
+                        if (node_mark_.set(wall_kick_node, node, 'x'))
                         {
-                            if (wall_kick_node->check(map))
+                            if (wall_kick_node->index_filtered == index)
                             {
-                                wall_kick_node = wall_kick_node->drop(map);
-                                if (node_mark_.set(wall_kick_node, node, 'x'))
-                                {
-                                    if (wall_kick_node->index_filtered == index)
-                                    {
-                                        return build_path(wall_kick_node, node_mark_);
-                                    }
-                                    else
-                                    {
-                                        node_search_.push_back(wall_kick_node);
-                                    }
-                                }
-                                break;
+                                return build_path(wall_kick_node, node_mark_);
+                            }
+                            else
+                            {
+                                node_search_.push_back(wall_kick_node);
                             }
-                        }
-                        else
-                        {
-                            break;
                         }
                     }
                 }
                 //z
-                for (TetrisNode const *wall_kick_node : node->wall_kick_counterclockwise)
+                if (TetrisNode const *wall_kick_node = node->wall_kick_counterclockwise.check_first(map))
                 {
-                    if (wall_kick_node)
+                    wall_kick_node = wall_kick_node->drop(map);
+                    if (node_mark_.set(wall_kick_node, node, 'z'))
                     {
-                        if (wall_kick_node->check(map))
+                        if (wall_kick_node->index_filtered == index)
                         {
-                            wall_kick_node = wall_kick_node->drop(map);
-                            if (node_mark_.set(wall_kick_node, node, 'z'))
-                            {
-                                if (wall_kick_node->index_filtered == index)
-                                {
-                                    return build_path(wall_kick_node, node_mark_);
-                                }
-                                else
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                            }
-                            break;
+                            return build_path(wall_kick_node, node_mark_);
+                        }
+                        else
+                        {
+                            node_search_.push_back(wall_kick_node);
                         }
-                    }
-                    else
-                    {
-                        break;
                     }
                 }
                 //c
-                for (TetrisNode const *wall_kick_node : node->wall_kick_clockwise)
+                if (TetrisNode const *wall_kick_node = node->wall_kick_clockwise.check_first(map))
                 {
-                    if (wall_kick_node)
+                    wall_kick_node = wall_kick_node->drop(map);
+                    if (node_mark_.set(wall_kick_node, node, 'c'))
                     {
-                        if (wall_kick_node->check(map))
+                        if (wall_kick_node->index_filtered == index)
                         {
-                            wall_kick_node = wall_kick_node->drop(map);
-                            if (node_mark_.set(wall_kick_node, node, 'c'))
-                            {
-                                if (wall_kick_node->index_filtered == index)
-                                {
-                                    return build_path(wall_kick_node, node_mark_);
-                                }
-                                else
-                                {
-                                    node_search_.push_back(wall_kick_node);
-                                }
-                            }
-                            break;
+                            return build_path(wall_kick_node, node_mark_);
+                        }
+                        else
+                        {
+                            node_search_.push_back(wall_kick_node);
                         }
-                    }
-                    else
-                    {
-                        break;
                     }
                 }
                 //l
@@ -976,7 +844,7 @@ namespace search_tspin
             node = node->drop(map);
         }
         node_search_.push_back(node);
-        node_mark_.mark(node);
+        node_mark_.set(node, nullptr, ' ');
         node_incomplete_.clear();
         size_t cache_index = 0;
         do
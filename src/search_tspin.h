@@ -1,4 +1,4 @@
-
+﻿
 #pragma once
 
 #include "tetris_core.h"
@@ -24,9 +24,8 @@ namespace search_tspin
         };
         struct TetrisNodeWithTSpinType
         {
-            TetrisNodeWithTSpinType()
+            TetrisNodeWithTSpinType() : node(), last(), type(), flags()
             {
-                std::memset(this, 0, sizeof(*this));
             }
             TetrisNodeWithTSpinType(m_tetris::TetrisNode const *_node) : node(_node), last(), type(None), flags()
             {
@@ -70,11 +69,12 @@ namespace search_tspin
         void init(m_tetris::TetrisContext const *context, Config const *config);
         std::vector<char> make_path(m_tetris::TetrisNode const *node, TetrisNodeWithTSpinType const &land_point, m_tetris::TetrisMap const &map);
         std::vector<TetrisNodeWithTSpinType> const *search(m_tetris::TetrisMap const &map, m_tetris::TetrisNode const *node, size_t depth);
+        //T落点的T-Spin预备判定,search_bitboard也用它们
+        bool check_ready(m_tetris::TetrisMap const &map, m_tetris::TetrisNode const *node);
+        bool check_mini_ready(m_tetris::TetrisMapSnap const &snap, TetrisNodeWithTSpinType const &node);
     private:
         std::vector<char> make_path_20g(m_tetris::TetrisNode const *node, TetrisNodeWithTSpinType const &land_point, m_tetris::TetrisMap const &map);
         std::vector<TetrisNodeWithTSpinType> const *search_t(m_tetris::TetrisMap const &map, m_tetris::TetrisNode const *node, size_t depth);
-        bool check_ready(m_tetris::TetrisMap const &map, m_tetris::TetrisNode const *node);
-        bool check_mini_ready(m_tetris::TetrisMapSnap const &snap, TetrisNodeWithTSpinType const &node);
         std::vector<TetrisNodeWithTSpinType> land_point_cache_;
         std::vector<m_tetris::TetrisNode const *> node_incomplete_;
         std::vector<m_tetris::TetrisNode const *> node_search_;
@@ -0,0 +1,371 @@
+﻿#include "tetris_core.h"
+#include "integer_utils.h"
+#include "search_tspin.h"
+#include "ai_zzz.h"
+#include "rule_srs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+typedef m_tetris::TetrisEngine<rule_srs::TetrisRule, ai_zzz::TOJ, search_tspin::Search> engine_t;
+
+//原来逐格扫描的写法,用来对照
+void init_t_value_ref(m_tetris::TetrisMap const &map, int16_t &t2_value_ref, int16_t &t3_value_ref, m_tetris::TetrisMap *out_map)
+{
+    int row_bit_count_global[40];
+    memset(row_bit_count_global, 0, sizeof row_bit_count_global);
+    for (int y = 0; y < map.roof; ++y)
+    {
+        row_bit_count_global[y] = ZZZ_BitCount(map.row[y]);
+    }
+    t2_value_ref = 0;
+    t3_value_ref = 0;
+    for (int y = 0; y < std::min(20, map.roof - 2); ++y)
+    {
+        int new_y = y;
+        int row0 = map.row[y];
+        int row1 = map.row[y + 1];
+        int row2 = y + 2 < map.height ? map.row[y + 2] : 0;
+        int row3 = y + 3 < map.height ? map.row[y + 3] : 0;
+        int row4 = y + 4 < map.height ? map.row[y + 4] : 0;
+        int row5 = y + 5 < map.height ? map.row[y + 5] : 0;
+        int row6 = y + 6 < map.height ? map.row[y + 6] : 0;
+        int *row_bit_count = row_bit_count_global + y;
+        for (int x = 1; x < map.width - 2; ++x)
+        {
+            if (((~row0 >> x) & 1) && ((~row1 >> x) & 3) == 3 && ((~row2 >> x) & 1) && ((row3 >> x) & 7) == 0 && ((~row4 >> x) & 6) == 6)
+            {
+                int t3_count = 0;
+                if (row_bit_count[0] == map.width - 1)
+                {
+                    t3_count += 1;
+                }
+                if (row_bit_count[1] == map.width - 2)
+                {
+                    t3_count += 1;
+                }
+                if (row_bit_count[2] == map.width - 1)
+                {
+                    t3_count += 1;
+                }
+                else
+                {
+                    continue;
+                }
+                int t3_bit_count = row_bit_count[0] + row_bit_count[1] + row_bit_count[2];
+                if (t3_count >= 2 && t3_bit_count > map.width * 2)
+                {
+                    int t3_value = t3_bit_count * t3_count;
+                    if ((row4 >> x) & 1)
+                    {
+                        t3_value += t3_bit_count + row_bit_count[3];
+                    }
+                    else if (((row4 >> x) & 7) == 1 && ((row5 >> x) & 7) == 1 && ((row6 >> x) & 7) == 1)
+                    {
+                        t3_value = 0;
+                    }
+                    else
+                    {
+                        t3_value /= 2;
+                    }
+                    if (((row3 >> x) & 8) != ((row4 >> x) & 8))
+                    {
+                        t3_value = 0;
+                    }
+                    if (t3_value > 0 && out_map != nullptr)
+                    {
+                        out_map->row[y + 0] |= 1 << x;
+                        out_map->row[y + 1] |= 3 << x;
+                        out_map->row[y + 2] |= 1 << x;
+                        out_map->row[y + 3] |= 1 << x;
+                    }
+                    t3_value_ref += t3_value;
+                    new_y += 2;
+                    break;
+                }
+            }
+        }
+        if (new_y != y)
+        {
+            y = new_y;
+            continue;
+        }
+        for (int x = 0; x < map.width - 3; ++x)
+        {
+            if (((~row0 >> x) & 4) && ((~row1 >> x) & 6) == 6 && ((~row2 >> x) & 4) && ((row3 >> x) & 7) == 0 && ((~row4 >> x) & 3) == 3)
+            {
+                int t3_count = 0;
+                if (row_bit_count[0] == map.width - 1)
+                {
+                    t3_count += 1;
+                }
+                if (row_bit_count[1] == map.width - 2)
+                {
+                    t3_count += 1;
+                }
+                if (row_bit_count[2] == map.width - 1)
+                {
+                    t3_count += 1;
+                }
+                else
+                {
+                    continue;
+                }
+                int t3_bit_count = row_bit_count[0] + row_bit_count[1] + row_bit_count[2];
+                if (t3_count >= 2 && t3_bit_count > map.width * 2)
+                {
+                    int t3_value = t3_bit_count * t3_count;
+                    if ((row2 >> x) & 2)
+                    {
+                        t3_value += t3_bit_count;
+                    }
+                    else if (((row4 >> x) & 7) == 4 && ((row5 >> x) & 7) == 4 && ((row6 >> x) & 7) == 4)
+                    {
+                        t3_value = 0;
+                    }
+                    else
+                    {
+                        t3_value /= 4;
+                    }
+                    if (((row3 >> x) & 1) != ((row4 >> x) & 1))
+                    {
+                        t3_value = 0;
+                    }
+                    if (t3_value > 0 && out_map != nullptr)
+                    {
+                        out_map->row[y + 0] |= 4 << x;
+                        out_map->row[y + 1] |= 6 << x;
+                        out_map->row[y + 2] |= 4 << x;
+                        out_map->row[y + 3] |= 4 << x;
+                    }
+                    t3_value_ref += t3_value;
+                    new_y += 2;
+                    break;
+                }
+            }
+        }
+        if (new_y != y)
+        {
+            y = new_y;
+            continue;
+        }
+        for (int x = 0; x < map.width - 2; ++x)
+        {
+            if (((row0 >> x) & 7) == 5 && ((row1 >> x) & 7) == 0)
+            {
+                int row01_count = row_bit_count[0] + row_bit_count[1];
+                int t2_value = row01_count;
+                if (row01_count > map.width)
+                {
+                    if (row_bit_count[0] == map.width - 1)
+                    {
+                        t2_value += row01_count;
+                    }
+                    if (row_bit_count[1] == map.width - 3)
+                    {
+                        t2_value += row01_count;
+                    }
+                    int row2_check = (row2 >> x) & 7;
+                    switch (row2_check)
+                    {
+                    case 1: case 4:
+                        t2_value += row01_count * 3;
+                        break;
+                    case 2: case 3: case 5: case 6: case 7:
+                        t2_value = 0;
+                        break;
+                    default:
+                        t2_value = t2_value / 2;
+                        break;
+                    }
+                    if (t2_value > 0 && out_map != nullptr)
+                    {
+                        out_map->row[y + 0] |= 2 << x;
+                        out_map->row[y + 1] |= 7 << x;
+                    }
+                    t2_value_ref += t2_value;
+                    ++new_y;
+                    break;
+                }
+                t2_value_ref += t2_value;
+            }
+        }
+        y = new_y;
+    }
+}
+
+//改完row之后重新算top,roof,count和哈希
+void fix_map(m_tetris::TetrisMap &map)
+{
+    map.roof = 0;
+    map.count = 0;
+    for (int x = 0; x < map.width; ++x)
+    {
+        map.top[x] = 0;
+    }
+    for (int y = 0; y < map.height; ++y)
+    {
+        if (map.row[y] == 0)
+        {
+            continue;
+        }
+        map.roof = y + 1;
+        map.count += int(ZZZ_BitCount(map.row[y]));
+        for (int x = 0; x < map.width; ++x)
+        {
+            if (map.full(x, y))
+            {
+                map.top[x] = y + 1;
+            }
+        }
+    }
+    map.rehash();
+}
+
+//随机垃圾行上随便放几块的中局场景
+m_tetris::TetrisMap make_midgame(m_tetris::TetrisContext const *context, std::mt19937 &r)
+{
+    m_tetris::TetrisMap map(context->width(), context->height());
+    int garbage = r() % 10;
+    for (int y = 0; y < garbage; ++y)
+    {
+        map.row[y] = context->full() & ~(1U << (r() % context->width()));
+    }
+    fix_map(map);
+    for (int i = r() % 16; i > 0; --i)
+    {
+        m_tetris::TetrisNode const *node = context->generate(r() % context->type_max());
+        for (int move = r() % 8; move > 0; --move)
+        {
+            m_tetris::TetrisNode const *next = (move & 1 ? node->move_left : node->move_right).get();
+            node = next != nullptr && next->check(map) ? next : node;
+        }
+        if (!node->check(map))
+        {
+            break;
+        }
+        node->drop(map)->attach(map);
+    }
+    return map;
+}
+
+//满行上挖一个T2或T3的坑,再随机加减几格,让各个分支都走得到
+m_tetris::TetrisMap make_slot(m_tetris::TetrisContext const *context, std::mt19937 &r)
+{
+    m_tetris::TetrisMap map(context->width(), context->height());
+    int width = context->width();
+    int fill = 3 + r() % 10;
+    for (int y = 0; y < fill; ++y)
+    {
+        map.row[y] = context->full();
+    }
+    int y = r() % (fill - 2);
+    int x = r() % (width - 3);
+    switch (r() % 3)
+    {
+    case 0:
+        map.row[y + 0] &= ~(1U << (x + 1));
+        map.row[y + 1] &= ~(7U << x);
+        map.row[y + 2] &= ~(7U << x);
+        break;
+    case 1:
+        map.row[y + 0] &= ~(1U << x);
+        map.row[y + 1] &= ~(3U << x);
+        map.row[y + 2] &= ~(1U << x);
+        map.row[y + 3] &= ~(7U << x);
+        map.row[y + 4] &= ~(6U << x);
+        break;
+    default:
+        map.row[y + 0] &= ~(4U << x);
+        map.row[y + 1] &= ~(6U << x);
+        map.row[y + 2] &= ~(4U << x);
+        map.row[y + 3] &= ~(7U << x);
+        map.row[y + 4] &= ~(3U << x);
+        break;
+    }
+    for (int i = r() % 4; i > 0; --i)
+    {
+        map.row[r() % (fill + 3)] ^= 1U << (r() % width);
+    }
+    fix_map(map);
+    return map;
+}
+
+template<class Func>
+void bench(char const *name, std::vector<m_tetris::TetrisMap> const &sample, size_t round, Func func)
+{
+    long long sink = 0;
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < round; ++i)
+    {
+        for (auto &map : sample)
+        {
+            sink += func(map);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - begin).count() / (round * sample.size());
+    std::cout << name << " ns_per_call=" << ns << " call_per_s=" << 1e9 / ns << " sink=" << sink << std::endl;
+}
+
+//用法: t_value_test [样本数] [轮数]
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? atoi(argv[1]) : 20000;
+    size_t round = argc > 2 ? atoi(argv[2]) : 50;
+    engine_t engine;
+    engine.prepare(10, 40);
+    m_tetris::TetrisContext const *context = engine.context().get();
+    std::mt19937 r(1);
+    std::vector<m_tetris::TetrisMap> midgame, slot;
+    while (midgame.size() < count)
+    {
+        midgame.push_back(make_midgame(context, r));
+    }
+    while (slot.size() < count)
+    {
+        slot.push_back(make_slot(context, r));
+    }
+
+    size_t mismatch = 0, t2_hit = 0, t3_hit = 0;
+    for (auto const *sample : { &midgame, &slot })
+    {
+        for (auto &map : *sample)
+        {
+            int16_t t2_ref, t3_ref, t2, t3;
+            m_tetris::TetrisMap out_ref = map, out = map;
+            init_t_value_ref(out_ref, t2_ref, t3_ref, &out_ref);
+            ai_zzz::TOJ::Status::init_t_value(out, t2, t3, &out);
+            mismatch += t2 != t2_ref || t3 != t3_ref || std::memcmp(out.row, out_ref.row, sizeof out.row) != 0;
+            init_t_value_ref(map, t2_ref, t3_ref, nullptr);
+            ai_zzz::TOJ::Status::init_t_value(map, t2, t3);
+            mismatch += t2 != t2_ref || t3 != t3_ref;
+            t2_hit += t2 != 0;
+            t3_hit += t3 != 0;
+        }
+    }
+    std::cout << "sample=" << midgame.size() + slot.size() << " round=" << round << " mismatch=" << mismatch << " t2_hit=" << t2_hit << " t3_hit=" << t3_hit << std::endl;
+
+    auto ref = [](m_tetris::TetrisMap const &map)
+    {
+        int16_t t2, t3;
+        m_tetris::TetrisMap t_map = map;
+        init_t_value_ref(t_map, t2, t3, &t_map);
+        return t2 + t3 + t_map.row[0];
+    };
+    auto bit = [](m_tetris::TetrisMap const &map)
+    {
+        int16_t t2, t3;
+        m_tetris::TetrisMap t_map = map;
+        ai_zzz::TOJ::Status::init_t_value(t_map, t2, t3, &t_map);
+        return t2 + t3 + t_map.row[0];
+    };
+    bench("midgame_ref", midgame, round, ref);
+    bench("midgame_bit", midgame, round, bit);
+    bench("slot_ref", slot, round, ref);
+    bench("slot_bit", slot, round, bit);
+}
@@ -0,0 +1,442 @@
+﻿
+#pragma once
+
+#include "tetris_core.h"
+
+namespace m_tetris
+{
+    //定宽束搜索,和TetrisEngine用同样的TetrisRule,TetrisAI,TetrisSearch,接口也一样,可以直接换掉
+    //每层是一个平铺的数组,整层一起展开评价,用nth_element留下最好的beam_width个,一直展开到预览用完
+    //没有搜索树的堆和节点缓存,每次run的工作量是固定的,适合20g和对战这种只要看完预览的场合
+    //预览里的'?'和之后的方块不看
+    template<class TetrisRule, class TetrisAI, class TetrisSearch>
+    class TetrisBeamEngine
+    {
+    private:
+        typedef TetrisCore<TetrisAI, TetrisSearch> Core;
+        typedef typename Core::LandPoint LandPoint;
+    public:
+        typedef typename Core::Status Status;
+    private:
+        struct Context;
+        struct RecordStatus
+        {
+            Status status;
+            Status const &get() const
+            {
+                return status;
+            }
+            Status const &get_raw() const
+            {
+                return status;
+            }
+            void set(Status const &_status)
+            {
+                status = _status;
+            }
+        };
+        //束里的一个局面
+        struct Record
+        {
+            Record(Context const *_context) : map(0, 0), identity(), result(), status(), context(_context), first(), pos(), hold(' '), level(), is_hold(), is_hold_lock()
+            {
+            }
+            TetrisMap map;
+            LandPoint identity;
+            typename Core::Result result;
+            RecordStatus status;
+            Context const *context;
+            //第一步是root_move的哪一个
+            size_t first;
+            //下一个要放的方块在context->next里的位置
+            uint32_t pos;
+            char hold;
+            uint8_t level;
+            bool is_hold;
+            bool is_hold_lock;
+
+            template<bool EnableEnv>
+            TetrisContext::Env env(Record const *child) const
+            {
+                TetrisContext::Env result =
+                {
+                    nullptr, 0, ' ', ' ', false
+                };
+                if (EnableEnv)
+                {
+                    size_t begin = std::min<size_t>(pos + 1, context->next.size());
+                    result.length = context->next.size() - begin;
+                    result.next = result.length == 0 ? nullptr : context->next.data() + begin;
+                    result.node = child->identity->status.t;
+                    result.hold = child->hold;
+                    result.is_hold = child->is_hold;
+                }
+                return result;
+            }
+        };
+        struct Context
+        {
+            //每个线程独占的数据,worker[0]给调用线程用
+            struct Worker
+            {
+                Worker()
+                {
+                    land_point_cache.init(4096);
+                }
+                TetrisSearch search;
+                TetrisLandPointCache<LandPoint> land_point_cache;
+
+                std::vector<LandPoint> const *land_point(TetrisMap const &map, TetrisNode const *node, size_t level)
+                {
+                    return land_point_cache.search(search, map, node, level);
+                }
+            };
+            Context() : engine(), ai(), beam_width(64), expand_count()
+            {
+            }
+            TetrisContext const *engine;
+            TetrisAI *ai;
+            std::vector<std::unique_ptr<Worker>> worker;
+            TetrisWorkerPool pool;
+            //每段节点展开出来的子节点,按段收集,结果和线程数无关
+            std::vector<std::vector<Record>> children;
+            //当前块和预览,到第一个'?'为止
+            std::vector<char> next;
+            size_t beam_width;
+            size_t expand_count;
+        };
+        typedef typename Context::Worker Worker;
+        typedef LocalContextBuilder<Context, TetrisRule, TetrisAI, TetrisSearch> ContextBuilder;
+
+        std::shared_ptr<TetrisContext> shared_context_;
+        typename ContextBuilder::LocalContext local_context_;
+        TetrisAI ai_;
+        //make_path/make_status/search用
+        TetrisSearch search_;
+        Status status_;
+        //当前层和下一层
+        std::vector<Record> layer_;
+        std::vector<Record> next_layer_;
+        std::vector<Record *> order_;
+        //第一层的落点,Record::first指向这里
+        std::vector<std::pair<LandPoint, bool>> root_move_;
+        Status best_status_;
+
+    public:
+        struct RunResult
+        {
+            RunResult() : target(), status(), change_hold()
+            {
+            }
+            RunResult(bool _change_hold) : target(), status(), change_hold(_change_hold)
+            {
+            }
+            RunResult(std::pair<LandPoint, bool> const &_move, Status const *_status) : target(_move.first), status(_status), change_hold(_move.second)
+            {
+            }
+            LandPoint target;
+            Status const *status;
+            bool change_hold;
+        };
+
+    public:
+        TetrisBeamEngine() : shared_context_(), ai_(), status_(), best_status_()
+        {
+            thread_count(1);
+        }
+        //net_cache:指针网缓存目录,见TetrisContext::prepare
+        bool prepare(int width, int height, char const *net_cache = nullptr)
+        {
+            if (shared_context_ != nullptr && shared_context_->width() == width && shared_context_->height() == height)
+            {
+                return true;
+            }
+            shared_context_.reset(new TetrisContext());
+            shared_context_->opertion_ = TetrisRule::get_opertion();
+            shared_context_->generate_ = TetrisRule::get_generate();
+            if (!shared_context_->prepare(width, height, net_cache))
+            {
+                shared_context_.reset();
+                return false;
+            }
+            local_context_.engine = shared_context_.get();
+            local_context_.ai = &ai_;
+            if (TetrisRuleInit<TetrisRule>::init(width, height))
+            {
+                ContextBuilder::init_ai(ai_, &local_context_, shared_context_.get());
+                ContextBuilder::init_search(search_, &local_context_, shared_context_.get());
+                for (auto &worker : local_context_.worker)
+                {
+                    ContextBuilder::init_search(worker->search, &local_context_, shared_context_.get());
+                    worker->land_point_cache.clear();
+                }
+            }
+            else
+            {
+                shared_context_.reset();
+                return false;
+            }
+            return true;
+        }
+        //从状态获取当前块
+        TetrisNode const *get(TetrisBlockStatus const &status) const
+        {
+            return shared_context_->get(status);
+        }
+        //上下文对象...
+        std::shared_ptr<TetrisContext> context() const
+        {
+            return shared_context_;
+        }
+        //AI名称
+        std::string ai_name() const
+        {
+            return ai_.ai_name();
+        }
+        auto ai_config() const->decltype(local_context_.ai_config())
+        {
+            return local_context_.ai_config();
+        }
+        auto ai_config()->decltype(local_context_.ai_config())
+        {
+            return local_context_.ai_config();
+        }
+        auto search_config() const->decltype(local_context_.search_config())
+        {
+            return local_context_.search_config();
+        }
+        auto search_config()->decltype(local_context_.search_config())
+        {
+            return local_context_.search_config();
+        }
+        //展开的线程数,默认1,只用调用线程,每层的节点分给各线程展开
+        void thread_count(size_t count)
+        {
+            count = std::max<size_t>(count, 1);
+            auto &worker = local_context_.worker;
+            size_t old_count = worker.size();
+            worker.resize(count);
+            for (size_t i = old_count; i < count; ++i)
+            {
+                worker[i].reset(new Worker());
+                if (shared_context_ != nullptr)
+                {
+                    ContextBuilder::init_search(worker[i]->search, &local_context_, shared_context_.get());
+                }
+            }
+            local_context_.pool.resize(count);
+        }
+        size_t thread_count() const
+        {
+            return local_context_.worker.size();
+        }
+        //每层留下的局面数,默认64
+        void beam_width(size_t width)
+        {
+            local_context_.beam_width = std::max<size_t>(width, 1);
+        }
+        size_t beam_width() const
+        {
+            return local_context_.beam_width;
+        }
+        //累计展开的节点数,和TetrisEngine::expand_count一样算
+        size_t expand_count() const
+        {
+            return local_context_.expand_count;
+        }
+        Status const *status() const
+        {
+            return &status_;
+        }
+        Status *status()
+        {
+            return &status_;
+        }
+        TetrisAI *ai()
+        {
+            return &ai_;
+        }
+        //update!改了搜索配置之后调用,清掉落点缓存
+        void update()
+        {
+            for (auto &worker : local_context_.worker)
+            {
+                worker->land_point_cache.clear();
+            }
+        }
+        //run!limit只用来提前结束,到时间就用已经展开完的最深一层
+        RunResult run(TetrisMap const &map, TetrisNode const *node, char const *next, size_t next_length, time_t limit = 100)
+        {
+            if (shared_context_ == nullptr || node == nullptr || !node->check(map))
+            {
+                return RunResult();
+            }
+            return run_<false>(map, node, ' ', true, next, next_length, limit);
+        }
+        //带hold的run!
+        RunResult run_hold(TetrisMap const &map, TetrisNode const *node, char hold, bool hold_free, char const *next, size_t next_length, time_t limit = 100)
+        {
+            if (shared_context_ == nullptr || node == nullptr || !node->check(map))
+            {
+                return RunResult();
+            }
+            if (hold == ' ' && (next_length == 0 || *next == '?') && hold_free)
+            {
+                return RunResult(true);
+            }
+            return run_<true>(map, node, hold, !hold_free, next, next_length, limit);
+        }
+        //根据run的结果得到一个操作路径
+        std::vector<char> make_path(TetrisNode const *node, LandPoint const &land_point, TetrisMap const &map, bool cut_drop = true)
+        {
+            auto path = search_.make_path(node, land_point, map);
+            if (cut_drop)
+            {
+                while (!path.empty() && (path.back() == 'd' || path.back() == 'D'))
+                {
+                    path.pop_back();
+                }
+            }
+            return path;
+        }
+        //根据run的结果得到一组按键状态
+        std::vector<char> make_status(TetrisNode const *node, LandPoint const &land_point, TetrisMap const &map)
+        {
+            return search_.make_status(node, land_point, map);
+        }
+        //单块评价
+        template<class container_t>
+        void search(TetrisNode const *node, TetrisMap const &map, container_t &result)
+        {
+            auto const *land_point = search_.search(map, node);
+            result.assign(land_point->begin(), land_point->end());
+        }
+
+    private:
+        template<bool EnableHold>
+        RunResult run_(TetrisMap const &map, TetrisNode const *node, char hold, bool hold_lock, char const *next, size_t next_length, time_t limit)
+        {
+            using namespace std::chrono;
+            auto end = high_resolution_clock::now() + milliseconds(limit);
+            auto &context = local_context_;
+            context.next.assign(1, node->status.t);
+            context.next.insert(context.next.end(), next, std::find(next, next + next_length, '?'));
+            root_move_.clear();
+            layer_.clear();
+            layer_.emplace_back(&context);
+            Record &root = layer_.back();
+            root.map = map;
+            root.status.set(status_);
+            root.hold = EnableHold ? hold : ' ';
+            root.is_hold_lock = hold_lock;
+            auto compare = [](Record const *left, Record const *right)
+            {
+                return right->status.get() < left->status.get();
+            };
+            while (true)
+            {
+                size_t chunk = std::max<size_t>(1, (layer_.size() + context.worker.size() * 4 - 1) / (context.worker.size() * 4));
+                size_t chunk_count = (layer_.size() + chunk - 1) / chunk;
+                if (context.children.size() < chunk_count)
+                {
+                    context.children.resize(chunk_count);
+                }
+                context.pool.run(chunk_count, [this, chunk](size_t index, size_t thread)
+                {
+                    Worker &worker = *local_context_.worker[thread];
+                    auto &children = local_context_.children[index];
+                    children.clear();
+                    for (size_t i = index * chunk, end = std::min(i + chunk, layer_.size()); i < end; ++i)
+                    {
+                        expand_<EnableHold>(worker, layer_[i], children);
+                    }
+                });
+                context.expand_count += layer_.size();
+                order_.clear();
+                for (size_t i = 0; i < chunk_count; ++i)
+                {
+                    for (auto &child : context.children[i])
+                    {
+                        order_.push_back(&child);
+                    }
+                }
+                if (order_.empty())
+                {
+                    break;
+                }
+                if (root_move_.empty())
+                {
+                    for (size_t i = 0; i < order_.size(); ++i)
+                    {
+                        order_[i]->first = i;
+                        root_move_.emplace_back(order_[i]->identity, order_[i]->is_hold);
+                    }
+                }
+                if (order_.size() > context.beam_width)
+                {
+                    std::nth_element(order_.begin(), order_.begin() + context.beam_width, order_.end(), compare);
+                    order_.resize(context.beam_width);
+                }
+                next_layer_.clear();
+                for (auto record : order_)
+                {
+                    next_layer_.push_back(*record);
+                }
+                layer_.swap(next_layer_);
+                if (limit > 0 && high_resolution_clock::now() >= end)
+                {
+                    break;
+                }
+            }
+            if (root_move_.empty())
+            {
+                return RunResult();
+            }
+            Record const *best = &*std::min_element(layer_.begin(), layer_.end(), [&compare](Record const &left, Record const &right)
+            {
+                return compare(&left, &right);
+            });
+            best_status_ = best->status.get_raw();
+            return RunResult(root_move_[best->first], &best_status_);
+        }
+        //hold的规则和TetrisTreeNode::search_children一样
+        template<bool EnableHold>
+        void expand_(Worker &worker, Record &record, std::vector<Record> &children)
+        {
+            auto &next = local_context_.next;
+            char piece = record.pos < next.size() ? next[record.pos] : ' ';
+            if (piece != ' ')
+            {
+                add_children_<EnableHold>(worker, record, children, piece, piece, false);
+            }
+            if (EnableHold && !record.is_hold_lock)
+            {
+                if (record.hold != ' ')
+                {
+                    add_children_<EnableHold>(worker, record, children, piece, record.hold, true);
+                }
+                else if (piece != ' ' && record.pos + 1 < next.size())
+                {
+                    add_children_<EnableHold>(worker, record, children, piece, next[record.pos + 1], true);
+                }
+            }
+        }
+        template<bool EnableHold>
+        void add_children_(Worker &worker, Record &record, std::vector<Record> &children, char piece, char type, bool is_hold)
+        {
+            uint32_t size = uint32_t(local_context_.next.size());
+            for (auto land_point : *worker.land_point(record.map, local_context_.engine->generate(type), record.level))
+            {
+                children.emplace_back(&local_context_);
+                Record &child = children.back();
+                Core::eval(*local_context_.ai, record.map, land_point, &child);
+                child.first = record.first;
+                child.is_hold = is_hold;
+                child.hold = EnableHold ? (is_hold ? piece : record.hold) : ' ';
+                child.pos = std::min(is_hold && record.hold == ' ' ? record.pos + 2 : record.pos + 1, size);
+                child.level = record.level + 1;
+                Core::template get<true>(*local_context_.ai, &child, &record);
+            }
+        }
+    };
+}
@@ -1,8 +1,21 @@
 ﻿
 #include <map>
+#include <new>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include "tetris_core.h"
 #include "random.h"
+#include "integer_utils.h"
+#if _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#elif __linux__
+#   include <cstdlib>
+#   include <sys/mman.h>
+#endif
 
 //这里就懒得标记注释了...
 //有心读的话...可以试试看调试跟踪一下...
@@ -17,6 +30,20 @@
 namespace m_tetris
 {
 
+    uint64_t const TetrisMap::hash_key[max_height] =
+    {
+        0xE220A8397B1DCDAFULL, 0x6E789E6AA1B965F5ULL, 0x06C45D188009454FULL, 0xF88BB8A8724C81EDULL,
+        0x1B39896A51A8749BULL, 0x53CB9F0C747EA2EBULL, 0x2C829ABE1F4532E1ULL, 0xC584133AC916AB3DULL,
+        0x3EE5789041C98AC3ULL, 0xF3B8488C368CB0A7ULL, 0x657EECDD3CB13D09ULL, 0xC2D326E0055BDEF7ULL,
+        0x8621A03FE0BBDB7BULL, 0x8E1F7555983AA92FULL, 0xB54E0F1600CC4D19ULL, 0x84BB3F97971D80ABULL,
+        0x7D29825C75521255ULL, 0xC3CF17102B7F7F87ULL, 0x3466E9A083914F65ULL, 0xD81A8D2B5A4485ADULL,
+        0xDB01602B100B9ED7ULL, 0xA9038A921825F10DULL, 0xEDF5F1D90DCA2F6BULL, 0x54496AD67BD2634DULL,
+        0xDD7C01D4F5407269ULL, 0x935E82F1DB4C4F7BULL, 0x69B82EBC92233301ULL, 0x40D29EB57DE1D511ULL,
+        0xA2F09DABB45C6317ULL, 0xEE521D7A0F4D3873ULL, 0xF16952EE72F3454FULL, 0x377D35DEA8E40225ULL,
+        0x0C7DE8064963BAB1ULL, 0x05582D37111AC529ULL, 0xD254741F599DC6F7ULL, 0x69630F7593D108C3ULL,
+        0x417EF96181DAA383ULL, 0x3C3C41A3B43343A1ULL, 0x6E19905DCBE531DFULL, 0x4FA9FA7324851729ULL
+    };
+
     void TetrisNode::build_snap(TetrisMap const &map, TetrisContext const *context, TetrisMapSnap &snap) const
     {
         for(int r = 0; r < 4; ++r)
@@ -66,21 +93,27 @@ namespace m_tetris
 
     size_t TetrisNode::attach(TetrisMap &map) const
     {
+        //方块和场景不重叠,或运算就是加法,哈希直接加上方块各行
         switch(height)
         {
         case 4:
             map.row[row + 3] |= data[3];
+            map.hash += data[3] * TetrisMap::hash_key[row + 3];
         case 3:
             map.row[row + 2] |= data[2];
+            map.hash += data[2] * TetrisMap::hash_key[row + 2];
         case 2:
             map.row[row + 1] |= data[1];
+            map.hash += data[1] * TetrisMap::hash_key[row + 1];
         case 1:
             map.row[row] |= data[0];
+            map.hash += data[0] * TetrisMap::hash_key[row];
         }
+        uint32_t full = map.width == 32 ? 0xFFFFFFFFU : (1U << map.width) - 1;
         int clear = 0;
         for(int i = height; i > 0; --i)
         {
-            if(map.row[row + i - 1] == context->full())
+            if(map.row[row + i - 1] == full)
             {
                 memmove(&map.row[row + i - 1], &map.row[row + i], (map.height - i) * sizeof(int));
                 map.row[map.height - 1] = 0;
@@ -118,27 +151,35 @@ namespace m_tetris
         map.count += 4 - clear * map.width;
         if(clear > 0)
         {
-            for(int x = 0; x < map.width; ++x)
+            //从roof往下按行扫,每行一次处理所有还没找到高度的列,全部找到就提前结束
+            uint32_t remain = full;
+            for(int y = map.roof - 1; y >= 0 && remain != 0; --y)
             {
-                map.top[x] = 0;
-                for(int y = map.roof - 1; y >= 0; --y)
+                uint32_t bits = map.row[y] & remain;
+                remain &= ~bits;
+                while(bits != 0)
                 {
-                    if(map.full(x, y))
-                    {
-                        map.top[x] = y + 1;
-                        break;
-                    }
+                    map.top[ZZZ_TrailingZeros(bits)] = y + 1;
+                    bits &= bits - 1;
                 }
             }
+            while(remain != 0)
+            {
+                map.top[ZZZ_TrailingZeros(remain)] = 0;
+                remain &= remain - 1;
+            }
+            //消行后上面的行都移动了,重算
+            map.rehash();
         }
         return clear;
     }
 
     int TetrisNode::clear_low(TetrisMap &map) const
     {
+        uint32_t full = map.width == 32 ? 0xFFFFFFFFU : (1U << map.width) - 1;
         for(int i = 0; i < height; ++i)
         {
-            if(map.row[row + i] == context->full())
+            if(map.row[row + i] == full)
             {
                 return row + i;
             }
@@ -148,9 +189,10 @@ namespace m_tetris
 
     int TetrisNode::clear_high(TetrisMap &map) const
     {
+        uint32_t full = map.width == 32 ? 0xFFFFFFFFU : (1U << map.width) - 1;
         for(int i = height; i > 0; --i)
         {
-            if(map.row[row + i - 1] == context->full())
+            if(map.row[row + i - 1] == full)
             {
                 return row + i - 1;
             }
@@ -175,7 +217,7 @@ namespace m_tetris
         }
         if(value >= 0)
         {
-            return move_down_multi[value];
+            return move_down_multi(value);
         }
         else
         {
@@ -322,21 +364,216 @@ namespace m_tetris
         return true;
     }
 
-    bool TetrisContext::prepare(int width, int height)
+    bool TetrisNodeSlab::huge_page = false;
+
+    TetrisNodeSlab::TetrisNodeSlab()
+    {
+    }
+
+    TetrisNodeSlab::~TetrisNodeSlab()
+    {
+        release();
+    }
+
+    TetrisNodeSlab::TetrisNodeSlab(TetrisNodeSlab &&other) : block_(std::move(other.block_))
+    {
+        other.block_.clear();
+    }
+
+    char *TetrisNodeSlab::grow(size_t node_size, size_t &count)
+    {
+        Block block = {nullptr, size_t(256) << 10, false};
+        if(huge_page)
+        {
+            size_t size = size_t(2) << 20;
+#if _WIN32
+            size_t large = GetLargePageMinimum();
+            if(large != 0)
+            {
+                size = (size + large - 1) / large * large;
+                block.data = static_cast<char *>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+            }
+#elif __linux__
+            void *data;
+            if(posix_memalign(&data, size, size) == 0)
+            {
+                madvise(data, size, MADV_HUGEPAGE);
+                block.data = static_cast<char *>(data);
+            }
+#endif
+            if(block.data != nullptr)
+            {
+                block.size = size;
+                block.huge = true;
+            }
+        }
+        if(block.data == nullptr)
+        {
+            block.data = static_cast<char *>(::operator new(block.size));
+        }
+        block_.push_back(block);
+        count = block.size / node_size;
+        return block.data;
+    }
+
+    void TetrisNodeSlab::merge(TetrisNodeSlab &other)
+    {
+        block_.insert(block_.end(), other.block_.begin(), other.block_.end());
+        other.block_.clear();
+    }
+
+    void TetrisNodeSlab::release()
+    {
+        for(auto &block : block_)
+        {
+            if(!block.huge)
+            {
+                ::operator delete(block.data);
+                continue;
+            }
+#if _WIN32
+            VirtualFree(block.data, 0, MEM_RELEASE);
+#elif __linux__
+            free(block.data);
+#endif
+        }
+        block_.clear();
+    }
+
+    TetrisWorkerPool::TetrisWorkerPool() : job_(), count_(), next_(), running_(), generation_(), exit_()
+    {
+    }
+
+    TetrisWorkerPool::~TetrisWorkerPool()
+    {
+        stop_();
+    }
+
+    void TetrisWorkerPool::resize(size_t count)
+    {
+        count = std::max<size_t>(count, 1);
+        if(count == thread_.size() + 1)
+        {
+            return;
+        }
+        stop_();
+        exit_ = false;
+        for(size_t i = 1; i < count; ++i)
+        {
+            thread_.emplace_back(&TetrisWorkerPool::work_, this, i, generation_);
+        }
+    }
+
+    size_t TetrisWorkerPool::size() const
+    {
+        return thread_.size() + 1;
+    }
+
+    void TetrisWorkerPool::run(size_t count, Job const &job)
+    {
+        if(thread_.empty() || count <= 1)
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                job(i, 0);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &job;
+            count_ = count;
+            next_ = 0;
+            running_ = thread_.size();
+            ++generation_;
+        }
+        wake_.notify_all();
+        for(size_t i; (i = next_++) < count;)
+        {
+            job(i, 0);
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return running_ == 0; });
+        job_ = nullptr;
+    }
+
+    void TetrisWorkerPool::work_(size_t thread, size_t generation)
+    {
+        while(true)
+        {
+            Job const *job;
+            size_t count;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return exit_ || generation_ != generation; });
+                if(exit_)
+                {
+                    return;
+                }
+                generation = generation_;
+                job = job_;
+                count = count_;
+            }
+            for(size_t i; (i = next_++) < count;)
+            {
+                (*job)(i, thread);
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(--running_ == 0)
+            {
+                done_.notify_one();
+            }
+        }
+    }
+
+    void TetrisWorkerPool::stop_()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            exit_ = true;
+        }
+        wake_.notify_all();
+        for(auto &thread : thread_)
+        {
+            thread.join();
+        }
+        thread_.clear();
+    }
+
+    //指针网缓存文件头,后面紧跟指针网数据
+    //指针网里没有绝对地址,映射进来就能直接用
+    struct TetrisNetCacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t node_size;
+        uint64_t key;
+        int32_t width, height;
+        uint32_t type_max;
+        uint32_t node_count;
+        uint64_t net_size;
+        uint32_t generate[256];
+    };
+    //节点布局或者构建方式变了就要改这个版本号
+    const uint32_t net_cache_version = 1;
+    const char net_cache_magic[8] = "mTetNet";
+
+    bool TetrisContext::prepare(int width, int height, char const *net_cache)
     {
         if(width > 32 || height > max_height || width < 4 || height < 4)
         {
             return false;
         }
-        place_cache_.clear();
         node_index_.clear();
-        node_storage_.clear();
+        net_storage_.clear();
+        net_mapping_.close();
+        node_storage_ = nullptr;
+        node_count_ = 0;
         node_block_.clear();
         width_ = width;
         height_ = height;
         type_max_ = 0;
         full_ = width == 32 ? 0xFFFFFFFFU : (1 << width) - 1;
-        std::vector<TetrisBlockStatus> check;
         for(auto cit = generate_.begin(); cit != generate_.end(); ++cit)
         {
             char type = cit->first;
@@ -346,13 +583,261 @@ namespace m_tetris
             ++type_max_;
         }
         node_block_.resize(type_max_ * 4);
+        std::vector<uint32_t> generate_index(type_max_);
+        if(net_cache == nullptr)
+        {
+            build_net_(generate_index.data());
+        }
+        else
+        {
+            uint64_t key = net_key_();
+            char name[64];
+            std::snprintf(name, sizeof name, "m_tetris_net_%016llx_%dx%d.bin", static_cast<unsigned long long>(key), width, height);
+            std::string path = net_cache;
+            if(!path.empty() && path.back() != '/' && path.back() != '\\')
+            {
+                path += '/';
+            }
+            path += name;
+            if(!load_net_(path.c_str(), key, generate_index.data()))
+            {
+                build_net_(generate_index.data());
+                save_net_(path.c_str(), key, generate_index.data());
+            }
+        }
+        index_net_(generate_index.data());
+        build_danger_();
+        return true;
+    }
+
+    uint64_t TetrisContext::net_key_() const
+    {
+        //FNV-1a,规则的函数没法比较,用它们对出生块的结果代替
+        uint64_t key = 14695981039346656037ULL;
+        auto hash = [&key](void const *data, size_t size)
+        {
+            for(size_t i = 0; i < size; ++i)
+            {
+                key = (key ^ static_cast<unsigned char const *>(data)[i]) * 1099511628211ULL;
+            }
+        };
+        auto hash_node = [&hash](TetrisNode const &node)
+        {
+            hash(&node.status.status, sizeof node.status.status);
+            hash(node.data, sizeof node.data);
+            hash(&node.row, sizeof node.row);
+            hash(&node.height, sizeof node.height);
+            hash(&node.col, sizeof node.col);
+            hash(&node.width, sizeof node.width);
+        };
+        uint32_t node_size = sizeof(TetrisNode);
+        hash(&net_cache_version, sizeof net_cache_version);
+        hash(&node_size, sizeof node_size);
+        hash(&width_, sizeof width_);
+        hash(&height_, sizeof height_);
+        for(auto cit = generate_.begin(); cit != generate_.end(); ++cit)
+        {
+            TetrisBlockStatus status = cit->second(this);
+            hash(&cit->first, sizeof cit->first);
+            hash(&status.status, sizeof status.status);
+        }
+        for(auto cit = opertion_.begin(); cit != opertion_.end(); ++cit)
+        {
+            TetrisOpertion const &op = cit->second;
+            hash(&cit->first.first, sizeof cit->first.first);
+            hash(&cit->first.second, sizeof cit->first.second);
+            if(op.create == nullptr)
+            {
+                continue;
+            }
+            TetrisNode node = op.create(width_, height_, op);
+            hash_node(node);
+#define ROTATE(func)\
+/**//**//**/do\
+/**//**//**/{\
+/**//**//**//**/TetrisNode copy = node;\
+/**//**//**//**/bool result = op.rotate_##func != nullptr && op.rotate_##func(copy, this);\
+/**//**//**//**/hash(&result, sizeof result);\
+/**//**//**//**/if(result)\
+/**//**//**//**/{\
+/**//**//**//**//**/hash_node(copy);\
+/**//**//**//**/}\
+/**//**//**//**/hash(&op.wall_kick_##func.length, sizeof op.wall_kick_##func.length);\
+/**//**//**//**/hash(op.wall_kick_##func.data, sizeof *op.wall_kick_##func.data * op.wall_kick_##func.length);\
+/**//**//**/} while(false)\
+/**//**//**/
+            ROTATE(clockwise);
+            ROTATE(counterclockwise);
+            ROTATE(opposite);
+#undef ROTATE
+        }
+        return key;
+    }
+
+    bool TetrisContext::load_net_(char const *path, uint64_t key, uint32_t *generate_index)
+    {
+        if(!net_mapping_.open(path))
+        {
+            return false;
+        }
+        TetrisNetCacheHeader const *header = reinterpret_cast<TetrisNetCacheHeader const *>(net_mapping_.data());
+        bool check = net_mapping_.size() > sizeof *header
+            && std::memcmp(header->magic, net_cache_magic, sizeof header->magic) == 0
+            && header->version == net_cache_version
+            && header->node_size == sizeof(TetrisNode)
+            && header->key == key
+            && header->width == width_
+            && header->height == height_
+            && header->type_max == type_max_
+            && header->net_size == net_mapping_.size() - sizeof *header
+            && header->node_count > 0
+            && uint64_t(header->node_count) * sizeof(TetrisNode) <= header->net_size;
+        for(size_t i = 0; check && i < type_max_; ++i)
+        {
+            check = header->generate[i] < header->node_count;
+        }
+        if(!check)
+        {
+            net_mapping_.close();
+            return false;
+        }
+        node_storage_ = reinterpret_cast<TetrisNode const *>(net_mapping_.data() + sizeof *header);
+        node_count_ = header->node_count;
+        std::copy(header->generate, header->generate + type_max_, generate_index);
+        return true;
+    }
+
+    void TetrisContext::save_net_(char const *path, uint64_t key, uint32_t const *generate_index) const
+    {
+        TetrisNetCacheHeader header = {};
+        std::memcpy(header.magic, net_cache_magic, sizeof header.magic);
+        header.version = net_cache_version;
+        header.node_size = sizeof(TetrisNode);
+        header.key = key;
+        header.width = width_;
+        header.height = height_;
+        header.type_max = uint32_t(type_max_);
+        header.node_count = uint32_t(node_count_);
+        header.net_size = net_storage_.size();
+        std::copy(generate_index, generate_index + type_max_, header.generate);
+        //多个进程可能同时写,先写临时文件再改名
+        std::string temp = path;
+        temp += '.';
+        temp += std::to_string(std::chrono::high_resolution_clock::now().time_since_epoch().count() ^ reinterpret_cast<uintptr_t>(this));
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if(!file.write(reinterpret_cast<char const *>(&header), sizeof header) || !file.write(net_storage_.data(), net_storage_.size()))
+            {
+                file.close();
+                std::remove(temp.c_str());
+                return;
+            }
+        }
+        if(std::rename(temp.c_str(), path) != 0)
+        {
+            std::remove(temp.c_str());
+        }
+    }
+
+    void TetrisContext::index_net_(uint32_t const *generate_index)
+    {
+        for(size_t i = 0; i < node_count_; ++i)
+        {
+            TetrisNode const &node = node_storage_[i];
+            node_index_.emplace(node.status, &node);
+            auto &block = node_block_[convert(node.status.t) * 4 + node.status.r];
+            if(block.count == 0)
+            {
+                for(int x = node.col; x < node.col + node.width; ++x)
+                {
+                    for(int y = 0; y < node.height; ++y)
+                    {
+                        if((node.data[y] >> x) & 1)
+                        {
+                            auto &b = block.data[block.count++];
+                            b.x = x - node.col;
+                            b.y = y;
+                        }
+                    }
+                }
+            }
+        }
         for(size_t i = 0; i < type_max_; ++i)
         {
-            node_storage_.emplace_back();
-            TetrisNode &node = node_storage_.back();
+            generate_cache_[i] = node_storage_ + generate_index[i];
+        }
+    }
+
+    void TetrisContext::build_danger_()
+    {
+        //先把每种块出生在空场景上的每一行存下来,再按起始行切4行做前缀并
+        //顶上多留3个空行,base可以取到max_height-1
+        size_t const stride = max_height + 3;
+        std::vector<uint32_t> spawn(type_max_ * stride);
+        for(size_t i = 0; i < type_max_; ++i)
+        {
+            TetrisMap map(width_, height_);
+            generate_cache_[i]->attach(map);
+            std::memcpy(&spawn[i * stride], map.row, max_height * sizeof *map.row);
+        }
+        danger_mask_.assign(max_height * (type_max_ + 1), TetrisDangerMask());
+        for(size_t base = 0; base < max_height; ++base)
+        {
+            TetrisDangerMask *mask = &danger_mask_[base * (type_max_ + 1)];
+            TetrisDangerMask &all = mask[type_max_];
+            for(size_t i = 0; i < type_max_; ++i)
+            {
+                std::memcpy(mask[i].data, &spawn[i * stride + base], sizeof mask[i].data);
+                for(int y = 0; y < 3; ++y)
+                {
+                    mask[i].data[y + 1] |= mask[i].data[y];
+                }
+                for(int y = 0; y < 4; ++y)
+                {
+                    all.data[y] |= mask[i].data[y];
+                }
+            }
+        }
+    }
+
+    void TetrisContext::build_net_(uint32_t *generate_index)
+    {
+        //先广搜出全部节点,这时候链接都是下标
+        enum
+        {
+            link_rotate_clockwise, link_rotate_counterclockwise, link_rotate_opposite, link_move_left, link_move_right, link_move_down, link_move_up, link_max
+        };
+        const uint32_t link_null = 0xFFFFFFFFU;
+        struct BuildNode
+        {
+            TetrisNode node;
+            uint32_t link[link_max];
+            uint32_t index_filtered;
+            size_t land_point;
+        };
+        std::vector<BuildNode> build;
+        chash_map<TetrisBlockStatus, uint32_t, TetrisBlockStatusHash, TetrisBlockStatusEqual> build_index;
+        auto insert = [&build, &build_index, link_null, this](TetrisNode const &node)->uint32_t
+        {
+            auto find = build_index.find(node.status);
+            if(find == build_index.end())
+            {
+                find = build_index.emplace(node.status, uint32_t(build.size())).first;
+                build.emplace_back();
+                BuildNode &build_node = build.back();
+                build_node.node = node;
+                std::fill(std::begin(build_node.link), std::end(build_node.link), link_null);
+                build_node.index_filtered = link_null;
+                build_node.land_point = type_max_;
+            }
+            return find->second;
+        };
+        std::vector<uint32_t> generate_build(type_max_);
+        for(size_t i = 0; i < type_max_; ++i)
+        {
+            TetrisNode node;
             create(generate_[convert(i)](this), node);
-            check.push_back(node.status);
-            node_index_.emplace(node.status, &node);
+            generate_build[i] = insert(node);
         }
         struct IndexFilter
         {
@@ -371,197 +856,159 @@ namespace m_tetris
             };
         };
         std::map<IndexFilter, uint32_t, IndexFilter::Less> index_filter;
-        TetrisMap map(width, height);
-        size_t check_index = 0;
-        do
+        TetrisMap map(width_, height_);
+        for(uint32_t check_index = 0; check_index < build.size(); ++check_index)
         {
-            for(size_t max_index = check.size(); check_index < max_index; ++check_index)
-            {
-                TetrisNode &node = *node_index_.find(check[check_index])->second;
-                node.index = check_index;
-                node.index_filtered = index_filter.insert(std::make_pair(node, uint32_t(check_index))).first->second;
-                node.context = this;
+            TetrisNode node = build[check_index].node;
+            TetrisOpertion op = get_opertion(node.status.t, node.status.r);
+            build[check_index].index_filtered = index_filter.insert(std::make_pair(node, check_index)).first->second;
 #define ROTATE(func)\
 /**//**//**//**/do\
 /**//**//**//**/{\
 /**//**//**//**//**/TetrisNode copy =\
 /**//**//**//**//**/{\
-/**//**//**//**//**//**/node.status, node.op, {node.data[0], node.data[1], node.data[2], node.data[3]}, {node.top[0], node.top[1], node.top[2], node.top[3]}, {node.bottom[0], node.bottom[1], node.bottom[2], node.bottom[3]}, node.row, node.height, node.col, node.width\
+/**//**//**//**//**//**/node.status, {node.data[0], node.data[1], node.data[2], node.data[3]}, {node.top[0], node.top[1], node.top[2], node.top[3]}, {node.bottom[0], node.bottom[1], node.bottom[2], node.bottom[3]}, node.row, node.height, node.col, node.width\
 /**//**//**//**//**/};\
-/**//**//**//**//**/if(copy.op.func != nullptr && copy.op.func(copy, this))\
+/**//**//**//**//**/if(op.func != nullptr && op.func(copy, this))\
 /**//**//**//**//**/{\
-/**//**//**//**//**//**/auto find = node_index_.find(copy.status);\
-/**//**//**//**//**//**/if(find == node_index_.end())\
-/**//**//**//**//**//**/{\
-/**//**//**//**//**//**//**/check.push_back(copy.status);\
-/**//**//**//**//**//**//**/node_storage_.emplace_back(copy);\
-/**//**//**//**//**//**//**/find = node_index_.emplace(copy.status, &node_storage_.back()).first;\
-/**//**//**//**//**//**/}\
-/**//**//**//**//**//**/node.func = find->second;\
+/**//**//**//**//**//**/uint32_t link = insert(copy);\
+/**//**//**//**//**//**/build[check_index].link[link_##func] = link;\
 /**//**//**//**//**/}\
 /**//**//**//**/} while(false)\
 /**//**//**//**/
-                ROTATE(rotate_clockwise);
-                ROTATE(rotate_counterclockwise);
-                ROTATE(rotate_opposite);
+            ROTATE(rotate_clockwise);
+            ROTATE(rotate_counterclockwise);
+            ROTATE(rotate_opposite);
 #undef ROTATE
 #define MOVE(func)\
 /**//**//**//**/do\
 /**//**//**//**/{\
 /**//**//**//**//**/TetrisNode copy =\
 /**//**//**//**//**/{\
-/**//**//**//**//**//**/node.status, node.op, {node.data[0], node.data[1], node.data[2], node.data[3]}, {node.top[0], node.top[1], node.top[2], node.top[3]}, {node.bottom[0], node.bottom[1], node.bottom[2], node.bottom[3]}, node.row, node.height, node.col, node.width\
+/**//**//**//**//**//**/node.status, {node.data[0], node.data[1], node.data[2], node.data[3]}, {node.top[0], node.top[1], node.top[2], node.top[3]}, {node.bottom[0], node.bottom[1], node.bottom[2], node.bottom[3]}, node.row, node.height, node.col, node.width\
 /**//**//**//**//**/};\
 /**//**//**//**//**/if(m_tetris_rule_tools::func(copy, this))\
 /**//**//**//**//**/{\
-/**//**//**//**//**//**/auto find = node_index_.find(copy.status);\
-/**//**//**//**//**//**/if(find == node_index_.end())\
-/**//**//**//**//**//**/{\
-/**//**//**//**//**//**//**/check.push_back(copy.status);\
-/**//**//**//**//**//**//**/node_storage_.emplace_back(copy);\
-/**//**//**//**//**//**//**/find = node_index_.emplace(copy.status, &node_storage_.back()).first;\
-/**//**//**//**//**//**/}\
-/**//**//**//**//**//**/node.func = find->second;\
+/**//**//**//**//**//**/uint32_t link = insert(copy);\
+/**//**//**//**//**//**/build[check_index].link[link_##func] = link;\
 /**//**//**//**//**/}\
 /**//**//**//**/} while(false)\
 /**//**//**//**/
-                MOVE(move_left);
-                MOVE(move_right);
-                MOVE(move_down);
-                MOVE(move_up);
+            MOVE(move_left);
+            MOVE(move_right);
+            MOVE(move_down);
+            MOVE(move_up);
 #undef MOVE
-                node.move_down_multi[0] = &node;
-                if(node.move_down)
-                {
-                    node.move_down_multi[1] = node.move_down;
-                    TetrisNode copy =
-                    {
-                        node.move_down->status, node.move_down->op, {node.move_down->data[0], node.move_down->data[1], node.move_down->data[2], node.move_down->data[3]}, {node.move_down->top[0], node.move_down->top[1], node.move_down->top[2], node.move_down->top[3]}, {node.move_down->bottom[0], node.move_down->bottom[1], node.move_down->bottom[2], node.move_down->bottom[3]}, node.move_down->row, node.move_down->height, node.move_down->col, node.move_down->width, node.move_down->low
-                    };
-                    int index = 2;
-                    while(m_tetris_rule_tools::move_down(copy, this))
-                    {
-                        auto find = node_index_.find(copy.status);
-                        if (find == node_index_.end())
-                        {
-                            check.push_back(copy.status);
-                            node_storage_.emplace_back(copy);
-                            find = node_index_.emplace(copy.status, &node_storage_.back()).first;
-                        }
-                        node.move_down_multi[index] = find->second;
-                        ++index;
-                    }
-                }
-                auto &block = node_block_[convert(node.status.t) * 4 + node.status.r];
-                if(block.count == 0)
+            if(build[check_index].link[link_move_down] != link_null)
+            {
+                TetrisNode copy = build[build[check_index].link[link_move_down]].node;
+                while(m_tetris_rule_tools::move_down(copy, this))
                 {
-                    for(int x = node.col; x < node.col + node.width; ++x)
-                    {
-                        for(int y = 0; y < node.height; ++y)
-                        {
-                            if((node.data[y] >> x) & 1)
-                            {
-                                auto &b = block.data[block.count++];
-                                b.x = x - node.col;
-                                b.y = y;
-                            }
-                        }
-                    }
+                    insert(copy);
                 }
             }
         }
-        while(check.size() > check_index);
+        //落点搜索优化用的数据
+        std::vector<std::vector<uint32_t>> land_point(type_max_);
         for(size_t i = 0; i < type_max_; ++i)
         {
-            TetrisNode node_generate;
-            create(generate_[convert(i)](this), node_generate);
-            TetrisNode const *node = generate_cache_[i] = get(node_generate.status);
-            place_cache_.insert(std::make_pair(node->status.t, std::vector<TetrisNode const *>()));
-            std::vector<TetrisNode const *> *land_point = &place_cache_.find(node->status.t)->second;
-            TetrisNode const *rotate = node;
+            uint32_t node = generate_build[i];
+            auto next_rotate = [&build, link_null](uint32_t rotate)
+            {
+                uint32_t const *link = build[rotate].link;
+                return link[link_rotate_counterclockwise] != link_null ? link[link_rotate_counterclockwise] : link[link_rotate_clockwise];
+            };
+            uint32_t rotate = node;
             do
             {
-                TetrisNode const *move = rotate;
-                while(move->move_left != nullptr)
+                uint32_t move = rotate;
+                while(build[move].link[link_move_left] != link_null)
                 {
-                    move = move->move_left;
+                    move = build[move].link[link_move_left];
                 }
                 do
                 {
-                    land_point->push_back(move);
-                    move = move->move_right;
+                    land_point[i].push_back(move);
+                    move = build[move].link[link_move_right];
                 }
-                while(move != nullptr);
-                rotate = rotate->rotate_counterclockwise != nullptr ? rotate->rotate_counterclockwise : rotate->rotate_clockwise;
+                while(move != link_null);
+                rotate = next_rotate(rotate);
             }
-            while(rotate != nullptr  && rotate != node);
+            while(rotate != link_null && rotate != node);
             rotate = node;
             int low = map.height;
             do
             {
-                for(int y = 0; y < rotate->width; ++y)
+                for(int y = 0; y < build[rotate].node.width; ++y)
                 {
-                    low = std::min(low, rotate->bottom[y]);
+                    low = std::min(low, build[rotate].node.bottom[y]);
                 }
-                rotate = rotate->rotate_counterclockwise != nullptr ? rotate->rotate_counterclockwise : rotate->rotate_clockwise;
+                rotate = next_rotate(rotate);
             }
-            while(rotate != nullptr  && rotate != node);
-            auto set_column_data = [land_point](TetrisNode const *node, int low)->void
+            while(rotate != link_null && rotate != node);
+            auto set_column_data = [&build, link_null, i](uint32_t node, int low)->void
             {
                 do
                 {
-                    TetrisNode *set_node = const_cast<TetrisNode *>(node);
-                    set_node->low = low--;
-                    set_node->land_point = land_point;
-                    node = set_node->move_down;
+                    build[node].node.low = low--;
+                    build[node].land_point = i;
+                    node = build[node].link[link_move_down];
                 }
-                while(node != nullptr);
+                while(node != link_null);
             };
             rotate = node;
             do
             {
-                TetrisNode const *move = rotate;
-                while(move->move_left != nullptr)
+                uint32_t move = rotate;
+                while(build[move].link[link_move_left] != link_null)
                 {
-                    move = move->move_left;
+                    move = build[move].link[link_move_left];
                 }
                 do
                 {
                     set_column_data(move, low);
-                    move = move->move_right;
+                    move = build[move].link[link_move_right];
                 }
-                while(move != nullptr);
-                rotate = rotate->rotate_counterclockwise;
+                while(move != link_null);
+                rotate = build[rotate].link[link_rotate_counterclockwise];
             }
-            while(rotate != nullptr  && rotate != node);
+            while(rotate != link_null && rotate != node);
         }
-        for(auto it = node_index_.begin(); it != node_index_.end(); ++it)
+        //踢墙序列
+        std::vector<uint32_t> wall_kick;
+        std::vector<size_t> wall_kick_offset;
+        for(uint32_t index = 0; index < build.size(); ++index)
         {
-            TetrisNode &node = *it->second;
+            TetrisNode const &node = build[index].node;
+            TetrisOpertion op = get_opertion(node.status.t, node.status.r);
 #define WALL_KICK(func)\
 /**//**//**/do\
 /**//**//**/{\
-/**//**//**//**/size_t wall_kick_index = 0;\
-/**//**//**//**/if(node.op.rotate_##func != nullptr)\
+/**//**//**//**/wall_kick_offset.push_back(wall_kick.size());\
+/**//**//**//**/if(op.rotate_##func != nullptr)\
 /**//**//**//**/{\
-/**//**//**//**//**/if(node.rotate_##func != nullptr)\
+/**//**//**//**//**/if(build[index].link[link_rotate_##func] != link_null)\
 /**//**//**//**//**/{\
-/**//**//**//**//**//**/++wall_kick_index;\
+/**//**//**//**//**//**/wall_kick.push_back(build[index].link[link_rotate_##func]);\
 /**//**//**//**//**/}\
-/**//**//**//**//**/TetrisNode copy = *generate(node.status.t);\
-/**//**//**//**//**/node.op.rotate_##func(copy, this);\
+/**//**//**//**//**/TetrisNode copy = build[generate_build[convert(node.status.t)]].node;\
+/**//**//**//**//**/op.rotate_##func(copy, this);\
 /**//**//**//**//**/TetrisBlockStatus status = copy.status;\
-/**//**//**//**//**/for(size_t i = 0; i < node.op.wall_kick_##func.length; ++i)\
+/**//**//**//**//**/for(size_t i = 0; i < op.wall_kick_##func.length; ++i)\
 /**//**//**//**//**/{\
-/**//**//**//**//**//**/TetrisWallKickOpertion::WallKickNode &n = node.op.wall_kick_##func.data[i];\
+/**//**//**//**//**//**/TetrisWallKickOpertion::WallKickNode &n = op.wall_kick_##func.data[i];\
 /**//**//**//**//**//**/TetrisBlockStatus wall_kick_status(status.t, node.status.x + n.x, node.status.y + n.y, status.r);\
 /**//**//**//**//**//**/if(create(wall_kick_status, copy))\
 /**//**//**//**//**//**/{\
-/**//**//**//**//**//**//**/node.wall_kick_##func[wall_kick_index++] = get(copy.status);\
+/**//**//**//**//**//**//**/auto find = build_index.find(copy.status);\
+/**//**//**//**//**//**//**/if(find == build_index.end())\
+/**//**//**//**//**//**//**/{\
+/**//**//**//**//**//**//**//**/break;\
+/**//**//**//**//**//**//**/}\
+/**//**//**//**//**//**//**/wall_kick.push_back(find->second);\
 /**//**//**//**//**//**/}\
 /**//**//**//**//**/}\
 /**//**//**//**/}\
-/**//**//**//**/node.wall_kick_##func[wall_kick_index++] = nullptr;\
 /**//**//**/} while(false)\
 /**//**//**/
             WALL_KICK(clockwise);
@@ -569,7 +1016,92 @@ namespace m_tetris
             WALL_KICK(opposite);
 #undef WALL_KICK
         }
-        return true;
+        wall_kick_offset.push_back(wall_kick.size());
+        //同一列的节点从上到下连续存放,这样下落不需要额外的表
+        std::vector<uint32_t> order, position(build.size(), link_null);
+        order.reserve(build.size());
+        for(uint32_t index = 0; index < build.size(); ++index)
+        {
+            if(position[index] != link_null)
+            {
+                continue;
+            }
+            uint32_t top = index;
+            while(build[top].link[link_move_up] != link_null)
+            {
+                top = build[top].link[link_move_up];
+            }
+            for(uint32_t node = top; node != link_null; node = build[node].link[link_move_down])
+            {
+                position[node] = uint32_t(order.size());
+                order.push_back(node);
+            }
+        }
+        assert(order.size() == build.size());
+        //最后把节点和链接表放进同一块内存
+        size_t land_point_count = 0;
+        for(auto const &list : land_point)
+        {
+            land_point_count += list.size();
+        }
+        size_t node_size = sizeof(TetrisNode) * build.size();
+        net_storage_.assign(node_size + sizeof(TetrisNodeLink) * (wall_kick.size() + land_point_count), 0);
+        TetrisNode *node_storage = reinterpret_cast<TetrisNode *>(net_storage_.data());
+        TetrisNodeLink *link_storage = reinterpret_cast<TetrisNodeLink *>(net_storage_.data() + node_size);
+        node_storage_ = node_storage;
+        node_count_ = build.size();
+        auto get_link = [node_storage, &position, link_null](uint32_t index)->TetrisNode const *
+        {
+            return index == link_null ? nullptr : node_storage + position[index];
+        };
+        auto set_list = [&link_storage, &get_link](TetrisNodeList &list, uint32_t const *begin, uint32_t const *end)
+        {
+            list.set(link_storage, end - begin);
+            for(; begin != end; ++begin)
+            {
+                new(link_storage++) TetrisNodeLink();
+                link_storage[-1].set(get_link(*begin));
+            }
+        };
+        for(uint32_t index = 0; index < build.size(); ++index)
+        {
+            BuildNode const &build_node = build[order[index]];
+            TetrisNode &node = *new(node_storage + index) TetrisNode(build_node.node);
+            node.index = index;
+            node.index_filtered = position[build_node.index_filtered];
+            node.move_left.set(get_link(build_node.link[link_move_left]));
+            node.move_right.set(get_link(build_node.link[link_move_right]));
+            node.move_down.set(get_link(build_node.link[link_move_down]));
+            node.move_up.set(get_link(build_node.link[link_move_up]));
+            size_t const *offset = &wall_kick_offset[order[index] * 3];
+            set_list(node.wall_kick_clockwise, wall_kick.data() + offset[0], wall_kick.data() + offset[1]);
+            set_list(node.wall_kick_counterclockwise, wall_kick.data() + offset[1], wall_kick.data() + offset[2]);
+            set_list(node.wall_kick_opposite, wall_kick.data() + offset[2], wall_kick.data() + offset[3]);
+            node.rotate_clockwise.set(node.wall_kick_clockwise.empty() ? nullptr : node.wall_kick_clockwise[0]);
+            node.rotate_counterclockwise.set(node.wall_kick_counterclockwise.empty() ? nullptr : node.wall_kick_counterclockwise[0]);
+            node.rotate_opposite.set(node.wall_kick_opposite.empty() ? nullptr : node.wall_kick_opposite[0]);
+            node.land_point.set(nullptr, 0);
+        }
+        std::vector<TetrisNodeList const *> land_point_list(type_max_);
+        for(size_t i = 0; i < type_max_; ++i)
+        {
+            TetrisNode &node = node_storage[position[land_point[i].front()]];
+            set_list(node.land_point, land_point[i].data(), land_point[i].data() + land_point[i].size());
+            land_point_list[i] = &node.land_point;
+        }
+        for(uint32_t index = 0; index < build.size(); ++index)
+        {
+            BuildNode const &build_node = build[order[index]];
+            if(build_node.land_point != type_max_)
+            {
+                TetrisNodeList const &list = *land_point_list[build_node.land_point];
+                node_storage[index].land_point.set(list.data(), list.size());
+            }
+        }
+        for(size_t i = 0; i < type_max_; ++i)
+        {
+            generate_index[i] = position[generate_build[i]];
+        }
     }
 
     int32_t TetrisContext::width() const
@@ -594,7 +1126,12 @@ namespace m_tetris
 
     size_t TetrisContext::node_max() const
     {
-        return node_index_.size();
+        return node_count_;
+    }
+
+    TetrisNode const *TetrisContext::get_node(size_t index) const
+    {
+        return node_storage_ + index;
     }
 
     size_t TetrisContext::convert(char type) const
@@ -681,7 +1218,12 @@ namespace m_tetris
         TetrisNode const *cache = get(status);
         if(cache != nullptr)
         {
-            node = *cache;
+            //链接是相对地址,拷贝出去就失效了,只保留方块数据
+            TetrisNode copy =
+            {
+                cache->status, {cache->data[0], cache->data[1], cache->data[2], cache->data[3]}, {cache->top[0], cache->top[1], cache->top[2], cache->top[3]}, {cache->bottom[0], cache->bottom[1], cache->bottom[2], cache->bottom[3]}, cache->row, cache->height, cache->col, cache->width, cache->low
+            };
+            node = copy;
             return true;
         }
         TetrisOpertion op = get_opertion(status.t, status.r);
@@ -717,17 +1259,22 @@ namespace m_tetris
         node = new_node;
         return true;
     }
+
+    TetrisDangerMask const *TetrisContext::danger_mask(int base) const
+    {
+        return &danger_mask_[base * (type_max_ + 1)];
+    }
 }
 
 namespace m_tetris_rule_tools
 {
-    TetrisNode create_node(size_t w, size_t h, char T, int8_t X, int8_t Y, uint8_t R, uint32_t line1, uint32_t line2, uint32_t line3, uint32_t line4, TetrisOpertion const &op)
+    TetrisNode create_node(size_t w, size_t h, char T, int8_t X, int8_t Y, uint8_t R, uint32_t line1, uint32_t line2, uint32_t line3, uint32_t line4, TetrisOpertion const &)
     {
         assert(X < 0 || X >= 4 || Y < 0 || Y >= 4 || (line1 || line2 || line3 || line3));
         TetrisBlockStatus status(T, X, int8_t(h - Y - 1), R);
         TetrisNode node =
         {
-            status, op, {line4, line3, line2, line1}, {}, {}, char(h - 4), char(4), char(0), char(4)
+            status, {line4, line3, line2, line1}, {}, {}, char(h - 4), char(4), char(0), char(4)
         };
         while(node.data[0] == 0)
         {
@@ -8,13 +8,22 @@
 #include <functional>
 #include <iterator>
 #include <map>
+#include <memory>
+#include <new>
 #include <queue>
 #include <string>
 #include <vector>
 #include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "chash_map.h"
 #include "chash_set.h"
+#include "dary_heap.h"
+#include "file_mapping.h"
+#include "integer_utils.h"
 
 namespace m_tetris
 {
@@ -43,11 +52,29 @@ namespace m_tetris
         int32_t roof;
         //场景的方块数
         int32_t count;
+        //场景哈希,每行数据乘以该行的随机奇数再求和,空场景为0
+        //TetrisNode::attach和加垃圾行时维护,直接改row之后要调用rehash
+        uint64_t hash;
+        static uint64_t const hash_key[max_height];
         //判定[x,y]坐标是否有方块
         inline bool full(size_t x, size_t y) const
         {
             return (row[y] >> x) & 1;
         }
+        //重新计算roof以下各行的哈希
+        uint64_t calc_hash() const
+        {
+            uint64_t result = 0;
+            for (int y = 0; y < roof; ++y)
+            {
+                result += row[y] * hash_key[y];
+            }
+            return result;
+        }
+        void rehash()
+        {
+            hash = calc_hash();
+        }
         TetrisMap()
         {
         }
@@ -69,13 +96,34 @@ namespace m_tetris
             }
             return *this;
         }
-        bool operator == (TetrisMap const &other)
+        //只拷贝roof以下的行,再把自己roof以上多出来的行清空
+        //要求两边都是有效的场景(roof以上全是空行),搜索树展开时用这个代替整体拷贝
+        void assign_roof(TetrisMap const &other)
+        {
+            if (other.roof < roof)
+            {
+                std::memset(row + other.roof, 0, (roof - other.roof) * sizeof *row);
+            }
+            std::memcpy(row, other.row, other.roof * sizeof *row);
+            if (other.width < width)
+            {
+                std::memset(top + other.width, 0, (width - other.width) * sizeof *top);
+            }
+            std::memcpy(top, other.top, other.width * sizeof *top);
+            width = other.width;
+            height = other.height;
+            roof = other.roof;
+            count = other.count;
+            hash = other.hash;
+        }
+        //哈希不同就一定不同,相同再比较整个场景
+        bool operator == (TetrisMap const &other) const
         {
-            return std::memcmp(this, &other, sizeof *this) == 0;
+            return hash == other.hash && std::memcmp(this, &other, sizeof *this) == 0;
         }
-        bool operator != (TetrisMap const &other)
+        bool operator != (TetrisMap const &other) const
         {
-            return std::memcmp(this, &other, sizeof *this) != 0;
+            return !(*this == other);
         }
     };
 
@@ -92,6 +140,17 @@ namespace m_tetris
         }
     };
 
+    //出生位置的方块在某4行里的掩码,data[k]是前k+1行的并
+    //场景这4行和它有交集就说明这种块出生会被挡住
+    struct TetrisDangerMask
+    {
+        uint32_t data[4];
+        inline bool check(TetrisMap const &map, int row) const
+        {
+            return ((data[0] & map.row[row]) | (data[1] & map.row[row + 1]) | (data[2] & map.row[row + 2]) | (data[3] & map.row[row + 3])) != 0;
+        }
+    };
+
     struct TetrisMapSnap
     {
         uint32_t row[4][max_height];
@@ -175,13 +234,120 @@ namespace m_tetris
         TetrisWallKickOpertion wall_kick_opposite;
     };
 
+    //指针网链接
+    //保存的是目标相对于链接自身的偏移,整张指针网位于一块连续内存中,可以整体搬迁(拷贝,共享内存,映射文件)
+    //只能作为指针网的成员存在,使用时转换成TetrisNode const *
+    class TetrisNodeLink
+    {
+        friend struct TetrisNode;
+    public:
+        TetrisNodeLink() : offset_()
+        {
+        }
+        TetrisNode const *get() const
+        {
+            return offset_ == 0 ? nullptr : reinterpret_cast<TetrisNode const *>(reinterpret_cast<char const *>(this) + offset_);
+        }
+        operator TetrisNode const *() const
+        {
+            return get();
+        }
+        TetrisNode const *operator->() const
+        {
+            return get();
+        }
+        void set(TetrisNode const *node)
+        {
+            offset_ = node == nullptr ? 0 : int32_t(reinterpret_cast<char const *>(node) - reinterpret_cast<char const *>(this));
+        }
+    private:
+        TetrisNodeLink(TetrisNodeLink const &) = default;
+        TetrisNodeLink &operator = (TetrisNodeLink const &) = default;
+        int32_t offset_;
+    };
+
+    //指针网链接表(踢墙序列,落点列表)
+    //链接本身存放在指针网的公共区域,这里同样只保存相对偏移
+    class TetrisNodeList
+    {
+        friend struct TetrisNode;
+    public:
+        class Iterator
+        {
+        public:
+            Iterator(TetrisNodeLink const *link) : link_(link)
+            {
+            }
+            TetrisNode const *operator *() const
+            {
+                return link_->get();
+            }
+            Iterator &operator ++()
+            {
+                ++link_;
+                return *this;
+            }
+            bool operator == (Iterator const &other) const
+            {
+                return link_ == other.link_;
+            }
+            bool operator != (Iterator const &other) const
+            {
+                return link_ != other.link_;
+            }
+        private:
+            TetrisNodeLink const *link_;
+        };
+        TetrisNodeList() : offset_(), length_()
+        {
+        }
+        TetrisNodeLink const *data() const
+        {
+            return reinterpret_cast<TetrisNodeLink const *>(reinterpret_cast<char const *>(this) + offset_);
+        }
+        Iterator begin() const
+        {
+            return data();
+        }
+        Iterator end() const
+        {
+            return data() + length_;
+        }
+        size_t size() const
+        {
+            return length_;
+        }
+        bool empty() const
+        {
+            return length_ == 0;
+        }
+        TetrisNode const *operator[](size_t index) const
+        {
+            return data()[index].get();
+        }
+        //逐项检查能否放入场景,返回位掩码(第i位对应第i项),要知道所有能放下的项时用,最多32项
+        uint32_t check(TetrisMap const &map) const;
+        //第一个能放入场景的项,没有就返回空(踢墙),找到就停
+        TetrisNode const *check_first(TetrisMap const &map) const;
+        void set(TetrisNodeLink const *data, size_t length)
+        {
+            offset_ = length == 0 ? 0 : int32_t(reinterpret_cast<char const *>(data) - reinterpret_cast<char const *>(this));
+            length_ = uint32_t(length);
+        }
+    private:
+        TetrisNodeList(TetrisNodeList const &) = default;
+        TetrisNodeList &operator = (TetrisNodeList const &) = default;
+        int32_t offset_;
+        uint32_t length_;
+    };
+
     //指针网节点
+    //这里只保留搜索时频繁访问的数据,方块操作函数之类的冷数据放在上下文中
+    //节点中没有绝对地址,同一列的节点从上到下连续存放
     struct TetrisNode
     {
         //方块状态
         TetrisBlockStatus status;
-        //方块操作函数
-        TetrisOpertion op;
         //方块每行的数据
         uint32_t data[4];
         //方块每列的上沿高度
@@ -196,43 +362,36 @@ namespace m_tetris
         //指针网索引
         //用于取代哈希表的hash
 
-        size_t index;
-        size_t index_filtered;
+        uint32_t index;
+        uint32_t index_filtered;
 
         //用于落点搜索优化
-        std::vector<TetrisNode const *> const *land_point;
+        TetrisNodeList land_point;
 
         //以下是指针网的数据
         //对应操作所造成的数据改变全都预置好,不需要再计算
         //如果为空,表示已经到达场景边界或者不支持该操作
 
-        TetrisNode const *move_left;
-        TetrisNode const *move_right;
-        TetrisNode const *move_down;
-        TetrisNode const *move_up;
+        TetrisNodeLink move_left;
+        TetrisNodeLink move_right;
+        TetrisNodeLink move_down;
+        TetrisNodeLink move_up;
 
-        //踢墙序列,依次尝试
-        //遇到nullptr,表示序列结束
-        union
-        {
-            TetrisNode const *rotate_clockwise;
-            TetrisNode const *wall_kick_clockwise[max_wall_kick];
-        };
-        union
-        {
-            TetrisNode const *rotate_counterclockwise;
-            TetrisNode const *wall_kick_counterclockwise[max_wall_kick];
-        };
-        union
-        {
-            TetrisNode const *rotate_opposite;
-            TetrisNode const *wall_kick_opposite[max_wall_kick];
-        };
+        //旋转,即对应踢墙序列的第一项
+        TetrisNodeLink rotate_clockwise;
+        TetrisNodeLink rotate_counterclockwise;
+        TetrisNodeLink rotate_opposite;
 
-        TetrisNode const *move_down_multi[max_height];
+        //踢墙序列,依次尝试
+        TetrisNodeList wall_kick_clockwise;
+        TetrisNodeList wall_kick_counterclockwise;
+        TetrisNodeList wall_kick_opposite;
 
-        //上下文...这个需要解释么?
-        TetrisContext const *context;
+        //下移n格后的节点(同一列连续存放,不需要额外的表)
+        TetrisNode const *move_down_multi(int n) const
+        {
+            return this + n;
+        }
 
         //检查当前块是否能够合并入场景
         bool check(TetrisMap const &map) const;
@@ -302,21 +461,185 @@ namespace m_tetris
         bool mark(TetrisNode const *key);
     };
 
+    //落点搜索结果的置换表.搜索树里不同的放置顺序会得到同样的场景,同样的场景+方块+深度直接用缓存的落点
+    //按TetrisMap::hash直接映射,冲突时覆盖,命中时比对roof以下的行,不会因为哈希冲突拿错结果
+    //返回的指针在下一次search之前有效,和TetrisSearch::search一样
+    template<class LandPoint>
+    class TetrisLandPointCache
+    {
+    private:
+        struct Entry
+        {
+            Entry() : version(0)
+            {
+            }
+            size_t version;
+            TetrisNode const *node;
+            size_t depth;
+            int32_t roof;
+            uint32_t row[max_height];
+            std::vector<LandPoint> land_point;
+        };
+        size_t version_;
+        size_t hit_;
+        size_t miss_;
+        std::vector<Entry> data_;
+
+        static size_t hash_(TetrisMap const &map, TetrisNode const *node, size_t depth)
+        {
+            uint64_t hash = map.hash ^ (uint64_t(node->index) << 8 | depth) * 0x9E3779B97F4A7C15ULL;
+            hash = (hash ^ hash >> 29) * 0xC2B2AE3D27D4EB4FULL;
+            return size_t(hash ^ hash >> 32);
+        }
+
+    public:
+        TetrisLandPointCache() : version_(1), hit_(0), miss_(0)
+        {
+        }
+        //size取2的幂,0表示不缓存
+        void init(size_t size)
+        {
+            assert((size & (size - 1)) == 0);
+            data_.clear();
+            data_.resize(size);
+            version_ = 1;
+        }
+        //搜索配置或者场景大小变了要清空
+        void clear()
+        {
+            ++version_;
+        }
+        size_t hit() const
+        {
+            return hit_;
+        }
+        size_t miss() const
+        {
+            return miss_;
+        }
+        template<class TetrisSearch>
+        std::vector<LandPoint> const *search(TetrisSearch &search, TetrisMap const &map, TetrisNode const *node, size_t depth)
+        {
+            if (data_.empty())
+            {
+                return search.search(map, node, depth);
+            }
+            Entry &entry = data_[hash_(map, node, depth) & (data_.size() - 1)];
+            if (entry.version == version_ && entry.node == node && entry.depth == depth && entry.roof == map.roof && std::memcmp(entry.row, map.row, map.roof * sizeof *map.row) == 0)
+            {
+                ++hit_;
+                return &entry.land_point;
+            }
+            ++miss_;
+            auto const *result = search.search(map, node, depth);
+            entry.version = version_;
+            entry.node = node;
+            entry.depth = depth;
+            entry.roof = map.roof;
+            std::memcpy(entry.row, map.row, map.roof * sizeof *map.row);
+            entry.land_point.assign(result->begin(), result->end());
+            return &entry.land_point;
+        }
+    };
+
+    //搜索树节点的内存块,一次申请一整块切成固定大小的节点,只在release时整体释放
+    class TetrisNodeSlab
+    {
+    public:
+        TetrisNodeSlab();
+        ~TetrisNodeSlab();
+        TetrisNodeSlab(TetrisNodeSlab &&other);
+        TetrisNodeSlab(TetrisNodeSlab const &) = delete;
+        TetrisNodeSlab &operator = (TetrisNodeSlab const &) = delete;
+        //huge_page:每块2MB,尽量用大页(linux透明大页,windows需要锁页权限,失败就用普通内存)
+        static bool huge_page;
+        //新申请一块,返回块地址,能放下的节点数放在count里
+        char *grow(size_t node_size, size_t &count);
+        //把other的块并过来,other清空
+        void merge(TetrisNodeSlab &other);
+        size_t block_count() const
+        {
+            return block_.size();
+        }
+        char *block(size_t index) const
+        {
+            return block_[index].data;
+        }
+        size_t block_size(size_t index) const
+        {
+            return block_[index].size;
+        }
+        void release();
+    private:
+        struct Block
+        {
+            char *data;
+            size_t size;
+            bool huge;
+        };
+        std::vector<Block> block_;
+    };
+
+    //展开搜索树用的线程池,调用线程也参与工作,线程数为1时不开线程
+    class TetrisWorkerPool
+    {
+    public:
+        typedef std::function<void(size_t, size_t)> Job;
+        TetrisWorkerPool();
+        ~TetrisWorkerPool();
+        TetrisWorkerPool(TetrisWorkerPool const &) = delete;
+        TetrisWorkerPool &operator = (TetrisWorkerPool const &) = delete;
+        //线程总数,包括调用线程
+        void resize(size_t count);
+        size_t size() const;
+        //对[0,count)的每个下标调用job(index, thread),thread是执行线程的编号(调用线程是0),全部完成后返回
+        void run(size_t count, Job const &job);
+    private:
+        //generation是创建线程时的任务代数,之后发布的任务才执行
+        void work_(size_t thread, size_t generation);
+        void stop_();
+        std::vector<std::thread> thread_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        Job const *job_;
+        size_t count_;
+        std::atomic<size_t> next_;
+        size_t running_;
+        size_t generation_;
+        bool exit_;
+    };
+
     template<class TetrisRule, class AI, class Search>
     struct TetrisContextBuilder;
 
+    template<class TetrisRule, class TetrisAI, class TetrisSearch>
+    class TetrisMCTSEngine;
+
+    template<class TetrisRule, class TetrisAI, class TetrisSearch>
+    class TetrisBeamEngine;
+
     //上下文对象.场景大小改变了需要重新初始化上下文
     class TetrisContext
     {
         template<class TetrisRule, class AI, class Search>
         friend class TetrisEngine;
+        template<class TetrisRule, class AI, class Search>
+        friend class TetrisMCTSEngine;
+        template<class TetrisRule, class AI, class Search>
+        friend class TetrisBeamEngine;
     private:
         TetrisContext()
         {
         }
         //指针网数据
-        std::deque<TetrisNode> node_storage_;
-        chash_map<TetrisBlockStatus, TetrisNode *, TetrisBlockStatusHash, TetrisBlockStatusEqual> node_index_;
+        //节点和链接表(踢墙序列,落点列表)都在这一块连续内存里
+        //自己构建的放在net_storage_,从缓存文件加载的直接映射在net_mapping_
+        std::vector<char> net_storage_;
+        zzz::FileMapping net_mapping_;
+        TetrisNode const *node_storage_;
+        size_t node_count_;
+        chash_map<TetrisBlockStatus, TetrisNode const *, TetrisBlockStatusHash, TetrisBlockStatusEqual> node_index_;
 
         //方块偏移数据
         std::vector<TetrisNodeBlockLocate> node_block_;
@@ -331,11 +654,19 @@ namespace m_tetris
         uint32_t full_;
 
         //一些用于加速的数据...
-        std::map<char, std::vector<TetrisNode const *>> place_cache_;
         size_t type_max_;
         TetrisNode const *generate_cache_[256];
         char index_to_type_[256];
         size_t type_to_index_[256];
+        //每个起始行base一组,按块种排,最后一个是所有块种的并
+        std::vector<TetrisDangerMask> danger_mask_;
+
+        uint64_t net_key_() const;
+        void build_net_(uint32_t *generate_index);
+        bool load_net_(char const *path, uint64_t key, uint32_t *generate_index);
+        void save_net_(char const *path, uint64_t key, uint32_t const *generate_index) const;
+        void index_net_(uint32_t const *generate_index);
+        void build_danger_();
 
     public:
         struct Env
@@ -351,7 +682,8 @@ namespace m_tetris
             fail = 0, ok = 1, rebuild = 2,
         };
         //初始化
-        bool prepare(int32_t width, int32_t height);
+        //net_cache:指针网缓存目录,按规则和宽高存取,为空则每次都重新构建
+        bool prepare(int32_t width, int32_t height, char const *net_cache = nullptr);
 
         int32_t width() const;
         int32_t height() const;
@@ -364,10 +696,33 @@ namespace m_tetris
         TetrisNodeBlockLocate const *get_block(char t, unsigned char r) const;
         TetrisNode const *get(TetrisBlockStatus const &status) const;
         TetrisNode const *get(char t, int8_t x, int8_t y, uint8_t r) const;
+        TetrisNode const *get_node(size_t index) const;
         TetrisNode const *generate(char type) const;
         TetrisNode const *generate(size_t index) const;
         TetrisNode const *generate() const;
         bool create(TetrisBlockStatus const &status, TetrisNode &node) const;
+        //出生位置取[base,base+4)行,返回type_max()+1个掩码
+        TetrisDangerMask const *danger_mask(int base) const;
+        //场景[row,row+4)行挡住了几种块的出生位置
+        //先用并集判一次,大部分局面到这里就返回了
+        inline size_t map_danger(TetrisMap const &map, int base, int row) const
+        {
+            TetrisDangerMask const *mask = &danger_mask_[base * (type_max_ + 1)];
+            if(!mask[type_max_].check(map, row))
+            {
+                return 0;
+            }
+            size_t danger = 0;
+            for(size_t i = 0; i < type_max_; ++i)
+            {
+                danger += mask[i].check(map, row);
+            }
+            return danger;
+        }
+        inline bool map_in_danger(TetrisMap const &map, int base, int row) const
+        {
+            return danger_mask_[base * (type_max_ + 1) + type_max_].check(map, row);
+        }
     };
 
     template<class TetrisAI>
@@ -615,6 +970,99 @@ namespace m_tetris
         typedef decltype(func<Derived>(nullptr)) type;
     };
 
+    //AI有eval_batch时搜索树把同一个场景展开的子节点攒起来一起评价
+    //void eval_batch(size_t count, LandPoint const *const *node, TetrisMap const *const *map, size_t const *clear, TetrisMap const &src_map, Result *const *result) const
+    //结果要和逐个调用eval一样
+    template<class TetrisAI>
+    struct TetrisAIHasEvalBatch
+    {
+        struct Fallback
+        {
+            int eval_batch;
+        };
+        struct Derived : TetrisAI, Fallback
+        {
+        };
+        template<typename U, U> struct Check;
+        template<typename U> static std::false_type func(Check<int Fallback::*, &U::eval_batch> *);
+        template<typename U> static std::true_type func(...);
+    public:
+        typedef decltype(func<Derived>(nullptr)) type;
+    };
+
+    template<class Status>
+    struct TetrisStatusHasKey
+    {
+        template<typename U> static std::true_type func(decltype(&U::key));
+        template<typename U> static std::false_type func(...);
+    public:
+        typedef decltype(func<Status>(nullptr)) type;
+    };
+
+    //搜索树的堆里存的比较键
+    //Status有key()就存key(),这时Status的operator<必须和key()的比较一致;是数就存它自己;否则存Status的指针
+    template<class Status, class = typename TetrisStatusHasKey<Status>::type, class = typename std::is_arithmetic<Status>::type>
+    struct TetrisStatusKey
+    {
+        typedef typename std::decay<decltype(std::declval<Status const &>().key())>::type type;
+        static type get(Status const &status)
+        {
+            return status.key();
+        }
+    };
+    template<class Status>
+    struct TetrisStatusKey<Status, std::false_type, std::true_type>
+    {
+        typedef Status type;
+        static type get(Status const &status)
+        {
+            return status;
+        }
+    };
+    template<class Status>
+    struct TetrisStatusKey<Status, std::false_type, std::false_type>
+    {
+        struct type
+        {
+            Status const *status;
+            bool operator < (type const &other) const
+            {
+                return *status < *other.status;
+            }
+        };
+        static type get(Status const &status)
+        {
+            return type{ &status };
+        }
+    };
+
+    //Status有transposition_key()时搜索树可以合并置换节点
+    //transposition_key()要包含会影响后续评价的状态(连击,b2b之类),不包含累计的分数
+    template<class Status>
+    struct TetrisStatusHasTransposition
+    {
+        template<typename U> static std::true_type func(decltype(&U::transposition_key));
+        template<typename U> static std::false_type func(...);
+    public:
+        typedef decltype(func<Status>(nullptr)) type;
+    };
+    template<class Status, class = typename TetrisStatusHasTransposition<Status>::type>
+    struct TetrisStatusTransposition
+    {
+        static uint64_t get(Status const &status)
+        {
+            return status.transposition_key();
+        }
+    };
+    template<class Status>
+    struct TetrisStatusTransposition<Status, std::false_type>
+    {
+        static uint64_t get(Status const &)
+        {
+            return 0;
+        }
+    };
+
     template<class Type>
     struct TetrisHasConfig
     {
@@ -801,6 +1249,21 @@ namespace m_tetris
             {
             }
         };
+        template<class EvalBatch, class>
+        struct TetrisSelectEvalBatch
+        {
+            static void eval(TetrisAI &ai, TetrisMap &map, EvalBatch &batch)
+            {
+                ai.eval_batch(batch.node.size(), batch.node.data(), batch.map.data(), batch.clear.data(), map, batch.result.data());
+            }
+        };
+        template<class EvalBatch>
+        struct TetrisSelectEvalBatch<EvalBatch, std::false_type>
+        {
+            static void eval(TetrisAI &, TetrisMap &, EvalBatch &)
+            {
+            }
+        };
         template<class TreeNode, bool EnableEnv, size_t>
         struct TetrisSelectGet
         {
@@ -840,14 +1303,48 @@ namespace m_tetris
     public:
         typedef typename TetrisSelectGet<void, false, TetrisAIInfo<TetrisAI>::arity>::enable_next_c EnableNextC;
 
+        //攒起来一起评价的子节点,只在AI有eval_batch时用
+        struct EvalBatch
+        {
+            std::vector<LandPoint const *> node;
+            std::vector<TetrisMap const *> map;
+            std::vector<size_t> clear;
+            std::vector<Result *> result;
+        };
         template<class TreeNode>
-        static void eval(TetrisAI &ai, TetrisMap &map, LandPoint &node, TreeNode *tree_node)
+        static size_t attach(TetrisMap &map, LandPoint &node, TreeNode *tree_node)
         {
             TetrisMap &new_map = tree_node->map;
-            new_map = map;
+            new_map.assign_roof(map);
             tree_node->identity = node;
-            size_t clear = node->attach(new_map);
-            tree_node->result = TetrisCallAI<TetrisAI, LandPoint>::eval(ai, tree_node->identity, new_map, map, clear);
+            return node->attach(new_map);
+        }
+        template<class TreeNode>
+        static void eval(TetrisAI &ai, TetrisMap &map, LandPoint &node, TreeNode *tree_node)
+        {
+            size_t clear = attach(map, node, tree_node);
+            tree_node->result = TetrisCallAI<TetrisAI, LandPoint>::eval(ai, tree_node->identity, tree_node->map, map, clear);
+        }
+        //先放好块,结果等eval_flush时一起算
+        template<class TreeNode>
+        static void eval_push(EvalBatch &batch, TetrisMap &map, LandPoint &node, TreeNode *tree_node)
+        {
+            batch.clear.push_back(attach(map, node, tree_node));
+            batch.node.push_back(&tree_node->identity);
+            batch.map.push_back(&tree_node->map);
+            batch.result.push_back(&tree_node->result);
+        }
+        static void eval_flush(TetrisAI &ai, TetrisMap &map, EvalBatch &batch)
+        {
+            if (batch.node.empty())
+            {
+                return;
+            }
+            TetrisSelectEvalBatch<EvalBatch, typename TetrisAIHasEvalBatch<TetrisAI>::type>::eval(ai, map, batch);
+            batch.node.clear();
+            batch.map.clear();
+            batch.clear.clear();
+            batch.result.clear();
         }
         template<class TreeNode>
         static double get_ratio(TetrisAI &ai)
@@ -873,11 +1370,19 @@ namespace m_tetris
         struct Context
         {
         public:
-            struct ValueHeapCompare
+            //堆里和节点一起存比较键,比较时不用访问节点
+            struct ValueKeyOf
+            {
+                typename TetrisStatusKey<Status>::type operator()(TetrisTreeNode *node) const
+                {
+                    return TetrisStatusKey<Status>::get(node->status.get());
+                }
+            };
+            struct PriorKeyOf
             {
-                bool operator()(TetrisTreeNode *left, TetrisTreeNode *right) const
+                int32_t operator()(TetrisTreeNode *node) const
                 {
-                    return left->status.get() < right->status.get();
+                    return node->prior;
                 }
             };
             template<class, class>
@@ -930,36 +1435,125 @@ namespace m_tetris
             };
             typedef TetrisNext<TetrisAI, typename TetrisAIHasIterate<TetrisAI>::type> next_t;
         public:
-            Context() : version(), is_complete(), is_open_hold(), width(), total(), avg()
+            Context() : version(), is_complete(), is_open_hold(), max_length(), width(), total(), avg(), node_limit(), evict_count(), expand_count(), stop(false), deadline(), has_deadline(), deadline_step(16), lazy_ratio(), transposition(), transposition_count(), land_point_cache_size(4096)
             {
+                resize_worker(1);
             }
+            //所有节点都在slab里,整块析构释放
             void release()
             {
-                for (auto node : tree_cache)
+                for (auto &item : worker)
                 {
-                    delete node;
+                    for (size_t i = 0; i < item.slab.block_count(); ++i)
+                    {
+                        char *block = item.slab.block(i);
+                        for (size_t j = 0, count = item.slab.block_size(i) / sizeof(TetrisTreeNode); j < count; ++j)
+                        {
+                            reinterpret_cast<TetrisTreeNode *>(block + j * sizeof(TetrisTreeNode))->~TetrisTreeNode();
+                        }
+                    }
+                    item.slab.release();
+                    item.tree_cache.clear();
+                    item.garbage = nullptr;
+                    item.capacity = 0;
                 }
             }
         public:
-            typedef std::priority_queue<TetrisTreeNode *, std::vector<TetrisTreeNode *>, ValueHeapCompare> value_heap_t;
+            typedef zzz::dary_heap<TetrisTreeNode *, ValueKeyOf> value_heap_t;
+            typedef zzz::dary_heap<TetrisTreeNode *, PriorKeyOf> prior_heap_t;
             typedef chash_map<TetrisBlockStatus, TetrisTreeNode *, TetrisBlockStatusHash, TetrisBlockStatusEqual> children_map_t;
             typedef chash_set<TetrisBlockStatus, TetrisBlockStatusHash, TetrisBlockStatusEqual> identity_set_t;
+            //展开节点时每个线程独占的数据,worker[0]给调用线程用
+            struct Worker
+            {
+                Context *context;
+                TetrisSearch *search;
+                TetrisLandPointCache<typename Core::LandPoint> land_point_cache;
+                children_map_t old;
+                identity_set_t uniq;
+                //节点从slab切出来,tree_cache是还没用过的节点
+                TetrisNodeSlab slab;
+                size_t capacity;
+                std::vector<TetrisTreeNode *> tree_cache;
+                //回收的子树,用parent串起来,分配时才拆开,回收是O(1)的
+                TetrisTreeNode *garbage;
+                std::vector<Status const *> iterate_cache;
+                typename Core::EvalBatch eval_batch;
+
+                //同样的场景直接用缓存的落点
+                std::vector<typename Core::LandPoint> const *land_point(TetrisMap const &map, TetrisNode const *node, size_t level)
+                {
+                    return land_point_cache.search(*search, map, node, level);
+                }
+                TetrisTreeNode *alloc(TetrisTreeNode *parent)
+                {
+                    TetrisTreeNode *node;
+                    if (garbage != nullptr)
+                    {
+                        //拆开一个回收的子树,它的子节点挂回回收链
+                        node = garbage;
+                        garbage = node->parent;
+                        for (auto it = node->children; it != nullptr; it = it->children_next)
+                        {
+                            it->parent = garbage;
+                            garbage = it;
+                        }
+                        node->children = nullptr;
+                        node->node_flag.clear();
+                        node->node = ' ';
+                        node->hold = ' ';
+                        node->level = 1;
+                        node->flag = 0;
+                    }
+                    else
+                    {
+                        if (tree_cache.empty())
+                        {
+                            grow_();
+                        }
+                        node = tree_cache.back();
+                        tree_cache.pop_back();
+                    }
+                    node->version = context->version - 1;
+                    node->parent = parent;
+                    return node;
+                }
+                //整个子树挂到回收链上,等分配时再拆
+                void dealloc(TetrisTreeNode *node)
+                {
+                    node->parent = garbage;
+                    garbage = node;
+                }
+                void grow_()
+                {
+                    size_t count;
+                    char *block = slab.grow(sizeof(TetrisTreeNode), count);
+                    capacity += count;
+                    for (size_t i = count; i-- > 0; )
+                    {
+                        tree_cache.push_back(new (block + i * sizeof(TetrisTreeNode)) TetrisTreeNode(context));
+                    }
+                }
+            };
             size_t version;
             TetrisContext const *engine;
             TetrisAI *ai;
-            TetrisSearch *search;
+            std::vector<Worker> worker;
+            TetrisWorkerPool pool;
+            std::vector<TetrisTreeNode *> batch;
+            std::vector<TetrisTreeNode *> children_buffer;
+            //置换表,同一局面只展开最好的节点,每个版本重建
+            chash_map<uint64_t, TetrisTreeNode *> transposition_table;
             std::vector<value_heap_t> sort;
             std::vector<value_heap_t> wait;
-            children_map_t old;
-            identity_set_t uniq;
+            //延迟评价的节点,按先验分排序,每轮评价前面的一些放进wait
+            std::vector<prior_heap_t> pending;
             bool is_complete;
             bool is_open_hold;
             bool is_virtual;
             bool unused_bool;
             size_t max_length;
             size_t width;
-            std::vector<TetrisTreeNode *> tree_cache;
-            std::vector<Status const *> iterate_cache;
             TetrisNode virtual_flag;
             TetrisNode const *current;
             std::vector<next_t> next;
@@ -967,36 +1561,150 @@ namespace m_tetris
             std::vector<double> width_cache;
             double total;
             double avg;
+            //节点数上限,0表示不限制
+            size_t node_limit;
+            //累计淘汰的节点数
+            size_t evict_count;
+            //累计展开的节点数,run按这个数算节点预算
+            size_t expand_count;
+            //后台思考要停下时置位,run在两层之间检查
+            std::atomic<bool> stop;
+            //截止时间,run在两层之间和每展开deadline_step*线程数个节点检查一次
+            std::chrono::high_resolution_clock::time_point deadline;
+            bool has_deadline;
+            size_t deadline_step;
+            //延迟评价,0表示不延迟,否则每层每轮评价要展开的节点数*lazy_ratio个延迟的节点
+            size_t lazy_ratio;
+            //合并置换节点,需要Status有transposition_key()
+            bool transposition;
+            //累计合并掉的节点数
+            size_t transposition_count;
+            //每个展开线程的落点缓存项数,0表示不缓存
+            size_t land_point_cache_size;
         public:
-            TetrisTreeNode *alloc(TetrisTreeNode *parent)
+            bool is_timeout() const
             {
-                TetrisTreeNode *node;
-                if (!tree_cache.empty())
+                return stop.load(std::memory_order_relaxed) || (has_deadline && std::chrono::high_resolution_clock::now() >= deadline);
+            }
+            //切出来的节点数,包括还没拆开的回收子树
+            size_t node_count() const
+            {
+                size_t count = 0;
+                for (auto &item : worker)
                 {
-                    node = tree_cache.back();
-                    tree_cache.pop_back();
-                    node->version = version - 1;
+                    count += item.capacity - item.tree_cache.size();
                 }
-                else
+                return count;
+            }
+            //节点数到了上限,并且没有能复用的回收节点时,从最深的待展开节点开始淘汰最差的,降到上限的3/4
+            //只淘汰wait里的节点,它们的子节点不在任何堆里,可以整个子树回收
+            void check_node_limit()
+            {
+                if (node_limit == 0)
                 {
-                    node = new TetrisTreeNode(this);
+                    return;
+                }
+                for (auto &item : worker)
+                {
+                    if (item.garbage != nullptr)
+                    {
+                        return;
+                    }
+                }
+                size_t count = node_count();
+                if (count < node_limit)
+                {
+                    return;
+                }
+                count -= node_limit / 4 * 3;
+                //还没评价的节点先淘汰
+                for (size_t i = 0; i < pending.size() && count > 0; ++i)
+                {
+                    count -= evict_heap_(pending[i], count);
+                }
+                for (size_t i = 0; i < wait.size() && count > 0; ++i)
+                {
+                    count -= evict_heap_(wait[i], count);
                 }
-                node->parent = parent;
-                return node;
             }
-            void dealloc(TetrisTreeNode *node)
+            //淘汰堆里最差的count个节点,返回淘汰的个数
+            template<class Heap>
+            size_t evict_heap_(Heap &heap, size_t count)
             {
-                for (auto it = node->children; it != nullptr; it = it->children_next)
+                size_t drop = std::min(count, heap.size());
+                std::vector<TetrisTreeNode *> &keep = batch;
+                keep.clear();
+                while (heap.size() > drop)
+                {
+                    keep.push_back(heap.top());
+                    heap.pop();
+                }
+                for (; !heap.empty(); heap.pop())
                 {
-                    dealloc(it);
+                    evict_(heap.top());
+                }
+                for (auto node : keep)
+                {
+                    heap.push(node);
+                }
+                evict_count += drop;
+                return drop;
+            }
+            void evict_(TetrisTreeNode *node)
+            {
+                if (transposition && !node->is_lazy)
+                {
+                    auto find = transposition_table.find(node->transposition_hash_());
+                    if (find != transposition_table.end() && find->second == node)
+                    {
+                        transposition_table.erase(find);
+                    }
+                }
+                for (auto link = &node->parent->children; *link != nullptr; link = &(*link)->children_next)
+                {
+                    if (*link == node)
+                    {
+                        *link = node->children_next;
+                        break;
+                    }
+                }
+                worker.front().dealloc(node);
+            }
+            //调整展开线程数,去掉的线程的节点内存交给worker[0],新线程的search由调用者设置
+            void resize_worker(size_t count)
+            {
+                count = std::max<size_t>(count, 1);
+                for (size_t i = count; i < worker.size(); ++i)
+                {
+                    Worker &main = worker.front(), &item = worker[i];
+                    main.slab.merge(item.slab);
+                    main.capacity += item.capacity;
+                    main.tree_cache.insert(main.tree_cache.end(), item.tree_cache.begin(), item.tree_cache.end());
+                    while (item.garbage != nullptr)
+                    {
+                        TetrisTreeNode *node = item.garbage;
+                        item.garbage = node->parent;
+                        main.dealloc(node);
+                    }
+                }
+                size_t old_count = worker.size();
+                worker.resize(count);
+                for (size_t i = old_count; i < count; ++i)
+                {
+                    worker[i].context = this;
+                    worker[i].search = nullptr;
+                    worker[i].garbage = nullptr;
+                    worker[i].capacity = 0;
+                    worker[i].land_point_cache.init(land_point_cache_size);
+                }
+                pool.resize(count);
+            }
+            void clear_land_point_cache()
+            {
+                for (auto &item : worker)
+                {
+                    item.land_point_cache.clear();
                 }
-                node->children = nullptr;
-                node->node_flag.clear();
-                node->node = ' ';
-                node->hold = ' ';
-                node->level = 1;
-                node->flag = 0;
-                tree_cache.push_back(node);
             }
         };
         struct TetrisNodeFlag
@@ -1085,7 +1793,8 @@ namespace m_tetris
             }
         };
         typedef typename Context::next_t next_t;
-        TetrisTreeNode(Context *_context) : node(' '), hold(' '), level(1), flag(), context(_context), version(context->version - 1), identity(), parent(), children()
+        typedef typename Context::Worker Worker;
+        TetrisTreeNode(Context *_context) : node(' '), hold(' '), level(1), flag(), prior(), context(_context), version(context->version - 1), map(0, 0), identity(), parent(), children()
         {
         }
         union
@@ -1106,8 +1815,12 @@ namespace m_tetris
                 uint8_t is_hold : 1;
                 uint8_t is_hold_lock : 1;
                 uint8_t is_virtual : 1;
+                uint8_t is_lazy : 1;
+                uint8_t is_transposed : 1;
             };
         };
+        //延迟评价的先验分,落点消行后的顶部越低越好
+        int32_t prior;
         Context *context;
         size_t version;
         TetrisMap map;
@@ -1122,6 +1835,7 @@ namespace m_tetris
 
         TetrisTreeNode *update_root(TetrisMap const &_map)
         {
+            assert(_map.hash == _map.calc_hash());
             if (map == _map)
             {
                 return this;
@@ -1129,7 +1843,8 @@ namespace m_tetris
             TetrisTreeNode *new_root = nullptr;
             for (TetrisTreeNode *it = children, *last = nullptr; it != nullptr; last = it, it = it->children_next)
             {
-                if (it->map == _map)
+                //延迟评价的节点还没有算场景
+                if (!it->is_lazy && it->map == _map)
                 {
                     new_root = it;
                     (last == nullptr ? children : last->children_next) = it->children_next;
@@ -1138,10 +1853,10 @@ namespace m_tetris
             }
             if (new_root == nullptr)
             {
-                new_root = context->alloc(nullptr);
+                new_root = context->worker.front().alloc(nullptr);
                 new_root->map = _map;
             }
-            context->dealloc(this);
+            context->worker.front().dealloc(this);
             new_root->parent = nullptr;
             return new_root;
         }
@@ -1151,10 +1866,14 @@ namespace m_tetris
             context->total += context->width;
             context->avg = context->total / context->version;
             context->width = 0;
+            context->clear_land_point_cache();
             context->wait.clear();
             context->sort.clear();
+            context->pending.clear();
+            context->transposition_table.clear();
             context->wait.resize(context->max_length + 1);
             context->sort.resize(context->max_length + 1);
+            context->pending.resize(context->max_length + 1);
         }
         std::vector<next_t> process_next(char const *_next, size_t _next_length, TetrisNode const *_node)
         {
@@ -1199,6 +1918,7 @@ namespace m_tetris
                 context->is_complete = false;
                 ++context->version;
                 context->current = _node;
+                context->transposition_table.clear();
             }
             root->status.set(status);
             context->width_cache.clear();
@@ -1235,20 +1955,61 @@ namespace m_tetris
                 context->is_complete = false;
                 ++context->version;
                 context->current = _node;
+                context->transposition_table.clear();
             }
             root->status.set(status);
             context->width_cache.clear();
             return root;
         }
-        void search(TetrisNode const *search_node, bool is_hold)
+        //这一层的子节点是否延迟评价,要用iterate的层必须马上评价
+        //run_virtual的子节点level可能已经越过预览的末尾
+        bool is_lazy_level_() const
+        {
+            return context->lazy_ratio != 0 && !(TetrisAIHasIterate<TetrisAI>::type::value && (level >= context->next.size() || context->next[level].get_vp()));
+        }
+        //延迟评价时只记下落点和先验分,放进wait之前再评价
+        void eval_child_(Worker &worker, typename Core::LandPoint &land_point, TetrisTreeNode *child)
+        {
+            if (is_lazy_level_())
+            {
+                uint32_t full = context->engine->full();
+                int32_t clear = 0;
+                for (int32_t y = 0; y < land_point->height; ++y)
+                {
+                    if ((map.row[land_point->row + y] | land_point->data[y]) == full)
+                    {
+                        ++clear;
+                    }
+                }
+                child->identity = land_point;
+                child->is_lazy = true;
+                child->prior = clear - land_point->row - land_point->height;
+            }
+            else if (TetrisAIHasEvalBatch<TetrisAI>::type::value)
+            {
+                //攒起来,search结束时一起评价
+                Core::eval_push(worker.eval_batch, map, land_point, child);
+            }
+            else
+            {
+                Core::eval(*context->ai, map, land_point, child);
+            }
+        }
+        void eval_lazy_()
+        {
+            Core::eval(*context->ai, parent->map, identity, this);
+            Core::template get<true>(*context->ai, this, parent);
+            is_lazy = false;
+        }
+        void search(Worker &worker, TetrisNode const *search_node, bool is_hold)
         {
             if (node_flag.empty())
             {
                 node_flag.set(search_node);
-                for (auto land_point_node : *context->search->search(map, search_node, level))
+                for (auto land_point_node : *worker.land_point(map, search_node, level))
                 {
-                    TetrisTreeNode *child = context->alloc(this);
-                    Core::eval(*context->ai, map, land_point_node, child);
+                    TetrisTreeNode *child = worker.alloc(this);
+                    eval_child_(worker, land_point_node, child);
                     child->is_hold = is_hold;
                     child->children_next = children;
                     children = child;
@@ -1257,13 +2018,13 @@ namespace m_tetris
             else if (!node_flag.check(search_node))
             {
                 node_flag.set(search_node);
-                auto &old = context->old;
+                auto &old = worker.old;
                 for (auto it = children; it != nullptr; it = it->children_next)
                 {
                     old.emplace(it->identity->status, it);
                 }
                 children = nullptr;
-                for (auto land_point_node : *context->search->search(map, search_node, level))
+                for (auto land_point_node : *worker.land_point(map, search_node, level))
                 {
                     TetrisTreeNode *child;
                     auto find = old.find(land_point_node->status);
@@ -1274,8 +2035,8 @@ namespace m_tetris
                     }
                     else
                     {
-                        child = context->alloc(this);
-                        Core::eval(*context->ai, map, land_point_node, child);
+                        child = worker.alloc(this);
+                        eval_child_(worker, land_point_node, child);
                     }
                     child->is_hold = is_hold;
                     child->children_next = children;
@@ -1283,27 +2044,28 @@ namespace m_tetris
                 }
                 for (auto &pair : old)
                 {
-                    context->dealloc(pair.second);
+                    worker.dealloc(pair.second);
                 }
                 old.clear();
             }
+            Core::eval_flush(*context->ai, map, worker.eval_batch);
         }
-        void search(TetrisNode const *search_node, TetrisNode const *hold_node)
+        void search(Worker &worker, TetrisNode const *search_node, TetrisNode const *hold_node)
         {
             if (search_node == hold_node)
             {
-                return search(search_node, false);
+                return search(worker, search_node, false);
             }
             if (search_node->status.t == hold_node->status.t)
             {
                 if (node_flag.empty())
                 {
                     node_flag.set(search_node, hold_node);
-                    auto &uniq = context->uniq;
-                    for (auto land_point_node : *context->search->search(map, search_node, level))
+                    auto &uniq = worker.uniq;
+                    for (auto land_point_node : *worker.land_point(map, search_node, level))
                     {
-                        TetrisTreeNode *child = context->alloc(this);
-                        Core::eval(*context->ai, map, land_point_node, child);
+                        TetrisTreeNode *child = worker.alloc(this);
+                        eval_child_(worker, land_point_node, child);
                         child->is_hold = false;
                         child->children_next = children;
                         children = child;
@@ -1311,14 +2073,14 @@ namespace m_tetris
                     }
                     if (children != nullptr)
                     {
-                        for (auto land_point_node : *context->search->search(map, hold_node, level))
+                        for (auto land_point_node : *worker.land_point(map, hold_node, level))
                         {
                             if (uniq.find(land_point_node->status) != uniq.end())
                             {
                                 continue;
                             }
-                            TetrisTreeNode *child = context->alloc(this);
-                            Core::eval(*context->ai, map, land_point_node, child);
+                            TetrisTreeNode *child = worker.alloc(this);
+                            eval_child_(worker, land_point_node, child);
                             child->is_hold = true;
                             child->children_next = children;
                             children = child;
@@ -1328,7 +2090,7 @@ namespace m_tetris
                 }
                 else if (!node_flag.check(search_node, hold_node))
                 {
-                    auto &old = context->old;
+                    auto &old = worker.old;
                     for (auto it = children; it != nullptr; it = it->children_next)
                     {
                         old.emplace(it->identity->status, it);
@@ -1337,7 +2099,7 @@ namespace m_tetris
                     if (node_flag.check(hold_node, search_node))
                     {
                         node_flag.set(search_node, hold_node);
-                        for (auto land_point_node : *context->search->search(map, search_node, level))
+                        for (auto land_point_node : *worker.land_point(map, search_node, level))
                         {
                             auto find = old.find(land_point_node->status);
                             assert(find != old.end());
@@ -1361,15 +2123,15 @@ namespace m_tetris
                         {
                             for (auto &pair : old)
                             {
-                                context->dealloc(pair.second);
+                                worker.dealloc(pair.second);
                             }
                         }
                     }
                     else
                     {
                         node_flag.set(search_node, hold_node);
-                        auto &uniq = context->uniq;
-                        for (auto land_point_node : *context->search->search(map, search_node, level))
+                        auto &uniq = worker.uniq;
+                        for (auto land_point_node : *worker.land_point(map, search_node, level))
                         {
                             TetrisTreeNode *child;
                             auto find = old.find(land_point_node->status);
@@ -1380,8 +2142,8 @@ namespace m_tetris
                             }
                             else
                             {
-                                child = context->alloc(this);
-                                Core::eval(*context->ai, map, land_point_node, child);
+                                child = worker.alloc(this);
+                                eval_child_(worker, land_point_node, child);
                             }
                             child->is_hold = false;
                             child->children_next = children;
@@ -1390,7 +2152,7 @@ namespace m_tetris
                         }
                         if (children != nullptr)
                         {
-                            for (auto land_point_node : *context->search->search(map, hold_node, level))
+                            for (auto land_point_node : *worker.land_point(map, hold_node, level))
                             {
                                 if (uniq.find(land_point_node->status) != uniq.end())
                                 {
@@ -1405,8 +2167,8 @@ namespace m_tetris
                                 }
                                 else
                                 {
-                                    child = context->alloc(this);
-                                    Core::eval(*context->ai, map, land_point_node, child);
+                                    child = worker.alloc(this);
+                                    eval_child_(worker, land_point_node, child);
                                 }
                                 child->is_hold = true;
                                 child->children_next = children;
@@ -1415,7 +2177,7 @@ namespace m_tetris
                         }
                         for (auto &pair : old)
                         {
-                            context->dealloc(pair.second);
+                            worker.dealloc(pair.second);
                         }
                         uniq.clear();
                     }
@@ -1427,20 +2189,20 @@ namespace m_tetris
                 if (node_flag.empty())
                 {
                     node_flag.set(search_node, hold_node);
-                    for (auto land_point_node : *context->search->search(map, search_node, level))
+                    for (auto land_point_node : *worker.land_point(map, search_node, level))
                     {
-                        TetrisTreeNode *child = context->alloc(this);
-                        Core::eval(*context->ai, map, land_point_node, child);
+                        TetrisTreeNode *child = worker.alloc(this);
+                        eval_child_(worker, land_point_node, child);
                         child->is_hold = false;
                         child->children_next = children;
                         children = child;
                     }
                     if (children != nullptr)
                     {
-                        for (auto land_point_node : *context->search->search(map, hold_node, level))
+                        for (auto land_point_node : *worker.land_point(map, hold_node, level))
                         {
-                            TetrisTreeNode *child = context->alloc(this);
-                            Core::eval(*context->ai, map, land_point_node, child);
+                            TetrisTreeNode *child = worker.alloc(this);
+                            eval_child_(worker, land_point_node, child);
                             child->is_hold = true;
                             child->children_next = children;
                             children = child;
@@ -1452,7 +2214,7 @@ namespace m_tetris
                     if (node_flag.check(hold_node, search_node))
                     {
                         node_flag.set(search_node, hold_node);
-                        if (!context->search->search(map, search_node, level)->empty())
+                        if (!worker.land_point(map, search_node, level)->empty())
                         {
                             for (auto it = children; it != nullptr; it = it->children_next)
                             {
@@ -1463,7 +2225,7 @@ namespace m_tetris
                         {
                             for (auto it = children; it != nullptr; it = it->children_next)
                             {
-                                context->dealloc(it);
+                                worker.dealloc(it);
                             }
                             children = nullptr;
                         }
@@ -1471,13 +2233,13 @@ namespace m_tetris
                     else
                     {
                         node_flag.set(search_node, hold_node);
-                        auto &old = context->old;
+                        auto &old = worker.old;
                         for (auto it = children; it != nullptr; it = it->children_next)
                         {
                             old.emplace(it->identity->status, it);
                         }
                         children = nullptr;
-                        for (auto land_point_node : *context->search->search(map, search_node, level))
+                        for (auto land_point_node : *worker.land_point(map, search_node, level))
                         {
                             TetrisTreeNode *child;
                             auto find = old.find(land_point_node->status);
@@ -1488,14 +2250,14 @@ namespace m_tetris
                             }
                             else
                             {
-                                child = context->alloc(this);
-                                Core::eval(*context->ai, map, land_point_node, child);
+                                child = worker.alloc(this);
+                                eval_child_(worker, land_point_node, child);
                             }
                             child->is_hold = false;
                             child->children_next = children;
                             children = child;
                         }
-                        for (auto land_point_node : *context->search->search(map, hold_node, level))
+                        for (auto land_point_node : *worker.land_point(map, hold_node, level))
                         {
                             TetrisTreeNode *child;
                             auto find = old.find(land_point_node->status);
@@ -1506,8 +2268,8 @@ namespace m_tetris
                             }
                             else
                             {
-                                child = context->alloc(this);
-                                Core::eval(*context->ai, map, land_point_node, child);
+                                child = worker.alloc(this);
+                                eval_child_(worker, land_point_node, child);
                             }
                             child->is_hold = true;
                             child->children_next = children;
@@ -1515,14 +2277,15 @@ namespace m_tetris
                         }
                         for (auto &pair : old)
                         {
-                            context->dealloc(pair.second);
+                            worker.dealloc(pair.second);
                         }
                         old.clear();
                     }
                 }
             }
+            Core::eval_flush(*context->ai, map, worker.eval_batch);
         }
-        void search()
+        void search(Worker &worker)
         {
             if (node_flag.empty())
             {
@@ -1530,10 +2293,10 @@ namespace m_tetris
                 size_t max = context->engine->type_max();
                 for (size_t i = 0; i < max; ++i)
                 {
-                    for (auto land_point_node : *context->search->search(map, context->engine->generate(i), level))
+                    for (auto land_point_node : *worker.land_point(map, context->engine->generate(i), level))
                     {
-                        TetrisTreeNode *child = context->alloc(this);
-                        Core::eval(*context->ai, map, land_point_node, child);
+                        TetrisTreeNode *child = worker.alloc(this);
+                        eval_child_(worker, land_point_node, child);
                         child->is_hold = false;
                         child->children_next = children;
                         children = child;
@@ -1543,7 +2306,7 @@ namespace m_tetris
             else if (node_flag.check(&context->virtual_flag))
             {
                 node_flag.set(&context->virtual_flag);
-                auto  &old = context->old;
+                auto  &old = worker.old;
                 for (auto it = children; it != nullptr; it = it->children_next)
                 {
                     old.emplace(it->identity->status, it);
@@ -1552,7 +2315,7 @@ namespace m_tetris
                 size_t max = context->engine->type_max();
                 for (size_t i = 0; i < max; ++i)
                 {
-                    for (auto land_point_node : *context->search->search(map, context->engine->generate(i), level))
+                    for (auto land_point_node : *worker.land_point(map, context->engine->generate(i), level))
                     {
                         TetrisTreeNode *child;
                         auto find = old.find(land_point_node->status);
@@ -1563,8 +2326,8 @@ namespace m_tetris
                         }
                         else
                         {
-                            child = context->alloc(this);
-                            Core::eval(*context->ai, map, land_point_node, child);
+                            child = worker.alloc(this);
+                            eval_child_(worker, land_point_node, child);
                         }
                         child->is_hold = false;
                         child->children_next = children;
@@ -1573,20 +2336,27 @@ namespace m_tetris
                 }
                 for (auto &pair : old)
                 {
-                    context->dealloc(pair.second);
+                    worker.dealloc(pair.second);
                 }
                 old.clear();
             }
+            Core::eval_flush(*context->ai, map, worker.eval_batch);
         }
-        void run_virtual()
+        void run_virtual(Worker &worker)
         {
-            search();
+            search(worker);
             auto *engine = context->engine;
-            auto &iterate_cache = context->iterate_cache;
+            auto &iterate_cache = worker.iterate_cache;
             iterate_cache.clear();
             iterate_cache.resize(context->engine->type_max(), nullptr);
             for (auto it = children; it != nullptr; it = it->children_next)
             {
+                //马上要拿去iterate,延迟的子节点也得先评价
+                if (it->is_lazy)
+                {
+                    Core::eval(*context->ai, map, it->identity, it);
+                    it->is_lazy = false;
+                }
                 Core::template get<false>(*context->ai, it, this);
                 auto &status = iterate_cache[engine->convert(it->identity->status.t)];
                 if (status == nullptr || *status < it->status.get())
@@ -1603,7 +2373,7 @@ namespace m_tetris
             {
                 TetrisContext::Env result =
                 {
-                    nullptr, 0, tree_node->identity->status.t, tree_node->is_hold ? node : hold
+                    nullptr, 0, tree_node->identity->status.t, tree_node->is_hold ? node : hold, tree_node->is_hold != 0
                 };
                 result.length = std::distance(next, context->next.cend());
                 if (result.length == 0)
@@ -1614,7 +2384,6 @@ namespace m_tetris
                 {
                     result.next = context->next_c.data() + (context->next_c.size() - result.length);
                 }
-                result.is_hold = tree_node->is_hold;
                 return result;
             }
             else
@@ -1626,14 +2395,14 @@ namespace m_tetris
             }
         }
         template<bool EnableHold>
-        TetrisTreeNode *build_children()
+        TetrisTreeNode *build_children(Worker &worker)
         {
             if (version == context->version || is_dead)
             {
                 return children;
             }
             version = context->version;
-            search_children<EnableHold>();
+            search_children<EnableHold>(worker);
             if (children == nullptr)
             {
                 is_dead = true;
@@ -1641,20 +2410,23 @@ namespace m_tetris
             }
             for (auto it = children; it != nullptr; it = it->children_next)
             {
-                Core::template get<true>(*context->ai, it, this);
+                if (!it->is_lazy)
+                {
+                    Core::template get<true>(*context->ai, it, this);
+                }
             }
             if (TetrisAIHasIterate<TetrisAI>::type::value && context->next[level].get_vp())
             {
                 for (auto it = children; it != nullptr; it = it->children_next)
                 {
                     it->level = level + 1;
-                    it->run_virtual();
+                    it->run_virtual(worker);
                 }
             }
             return children;
         }
         template<bool EnableHold>
-        void search_children()
+        void search_children(Worker &worker)
         {
             if (parent == nullptr)
             {
@@ -1666,28 +2438,28 @@ namespace m_tetris
                     {
                         if (is_hold_lock || next == context->next.end())
                         {
-                            search(context->current, false);
+                            search(worker, context->current, false);
                         }
                         else
                         {
-                            search(context->current, context->engine->generate(next->node));
+                            search(worker, context->current, context->engine->generate(next->node));
                         }
                     }
                     else
                     {
                         if (is_hold_lock)
                         {
-                            search(context->current, false);
+                            search(worker, context->current, false);
                         }
                         else
                         {
-                            search(context->current, context->engine->generate(hold));
+                            search(worker, context->current, context->engine->generate(hold));
                         }
                     }
                 }
                 else
                 {
-                    search(context->current, false);
+                    search(worker, context->current, false);
                 }
                 return;
             }
@@ -1718,22 +2490,22 @@ namespace m_tetris
                 {
                     if (next == context->next.end())
                     {
-                        search(context->engine->generate(node), false);
+                        search(worker, context->engine->generate(node), false);
                     }
                     else
                     {
-                        search(context->engine->generate(node), context->engine->generate(next->node));
+                        search(worker, context->engine->generate(node), context->engine->generate(next->node));
                     }
                 }
                 else
                 {
                     if (node == ' ')
                     {
-                        search(context->engine->generate(hold), true);
+                        search(worker, context->engine->generate(hold), true);
                     }
                     else
                     {
-                        search(context->engine->generate(node), context->engine->generate(hold));
+                        search(worker, context->engine->generate(node), context->engine->generate(hold));
                     }
                 }
             }
@@ -1742,7 +2514,107 @@ namespace m_tetris
                 assert(parent->next != context->next.end());
                 node = parent->next->node;
                 next = std::next(parent->next);
-                search(context->engine->generate(node), false);
+                search(worker, context->engine->generate(node), false);
+            }
+        }
+        //多线程时分给各线程展开,每个线程用自己的Worker
+        template<bool EnableHold>
+        void build_batch(TetrisTreeNode *const *batch, size_t count)
+        {
+            auto &worker = context->worker;
+            context->pool.run(count, [batch, &worker](size_t index, size_t thread)
+            {
+                batch[index]->template build_children<EnableHold>(worker[thread]);
+            });
+        }
+        //置换节点的键:场景,hold,预览用到哪里,Status里影响后续的部分,这些相同的节点往后展开的结果一样
+        //深度由预览位置和hold确定,不用另外算
+        uint64_t transposition_hash_() const
+        {
+            char child_hold = is_hold ? parent->node : parent->hold;
+            auto child_next = is_hold && parent->hold == ' ' ? std::next(parent->next) : parent->next;
+            uint64_t hash = map.hash;
+            hash = (hash ^ uint8_t(child_hold)) * 0x9E3779B97F4A7C15ULL;
+            hash = (hash ^ uint64_t(std::distance(context->next.cbegin(), child_next))) * 0x9E3779B97F4A7C15ULL;
+            hash = (hash ^ TetrisStatusTransposition<Status>::get(status.get_raw())) * 0x9E3779B97F4A7C15ULL;
+            return hash ^ (hash >> 29);
+        }
+        bool is_transposition_(TetrisTreeNode const *other) const
+        {
+            return map == other->map
+                && (is_hold ? parent->node : parent->hold) == (other->is_hold ? other->parent->node : other->parent->hold)
+                && (is_hold && parent->hold == ' ' ? std::next(parent->next) : parent->next) == (other->is_hold && other->parent->hold == ' ' ? std::next(other->parent->next) : other->parent->next)
+                && TetrisStatusTransposition<Status>::get(status.get_raw()) == TetrisStatusTransposition<Status>::get(other->status.get_raw());
+        }
+        //放进wait前查置换表,已经有更好的同类节点就返回false,不用展开
+        //比已有的好就顶替它,还没展开的那个弹出时跳过
+        bool check_transposition_()
+        {
+            is_transposed = false;
+            if (!TetrisStatusHasTransposition<Status>::type::value || !context->transposition)
+            {
+                return true;
+            }
+            auto result = context->transposition_table.emplace(transposition_hash_(), this);
+            if (result.second)
+            {
+                return true;
+            }
+            TetrisTreeNode *other = result.first->second;
+            if (other == this)
+            {
+                return true;
+            }
+            if (!is_transposition_(other))
+            {
+                result.first->second = this;
+                return true;
+            }
+            ++context->transposition_count;
+            if (other->status.get() < status.get())
+            {
+                other->is_transposed = true;
+                result.first->second = this;
+                return true;
+            }
+            is_transposed = true;
+            return false;
+        }
+        //从延迟评价的堆里取先验分最高的count个,评价后放进wait
+        void eval_pending_(typename Context::prior_heap_t &pending, typename Context::value_heap_t &wait, size_t count)
+        {
+            auto &batch = context->batch;
+            batch.clear();
+            while (batch.size() < count && !pending.empty())
+            {
+                batch.push_back(pending.top());
+                pending.pop();
+            }
+            context->pool.run(batch.size(), [&batch](size_t index, size_t)
+            {
+                batch[index]->eval_lazy_();
+            });
+            for (auto node : batch)
+            {
+                if (node->check_transposition_())
+                {
+                    wait.push(node);
+                }
+            }
+        }
+        //延迟评价的子节点放进pending,其余的攒进buffer,之后一起放进wait
+        void push_children_(size_t length, std::vector<TetrisTreeNode *> &buffer)
+        {
+            for (auto it = children; it != nullptr; it = it->children_next)
+            {
+                if (it->is_lazy)
+                {
+                    context->pending[length].push(it);
+                }
+                else if (it->check_transposition_())
+                {
+                    buffer.push_back(it);
+                }
             }
         }
         template<bool EnableHold>
@@ -1755,11 +2627,12 @@ namespace m_tetris
             assert(parent == nullptr);
             if (context->width == 0)
             {
-                auto &wait = context->wait.back();
-                for (auto it = build_children<EnableHold>(); it != nullptr; it = it->children_next)
-                {
-                    wait.push(it);
-                }
+                auto &buffer = context->children_buffer;
+                buffer.clear();
+                build_children<EnableHold>(context->worker.front());
+                push_children_(context->max_length, buffer);
+                context->wait.back().push(buffer.begin(), buffer.end());
+                ++context->expand_count;
                 context->width = 2;
             }
             else
@@ -1775,9 +2648,22 @@ namespace m_tetris
             }
             while (next_length > 0)
             {
+                if (context->is_timeout())
+                {
+                    return false;
+                }
+                context->check_node_limit();
                 size_t level_prune_hold = std::max<size_t>(1, size_t(context->width_cache[next_length] * context->width));
                 --next_length;
                 auto wait = &context->wait[next_length + 1];
+                auto sort = &context->sort[next_length + 1];
+                //延迟评价的节点每轮评价一些,和wait里已经评价的一起挑
+                if (!context->pending[next_length + 1].empty())
+                {
+                    auto &pending = context->pending[next_length + 1];
+                    size_t need = level_prune_hold > sort->size() ? level_prune_hold - sort->size() : 1;
+                    eval_pending_(pending, *wait, context->lazy_ratio == 0 ? pending.size() : need * context->lazy_ratio);
+                }
                 if (wait->empty())
                 {
                     continue;
@@ -1786,18 +2672,24 @@ namespace m_tetris
                 {
                     complete = false;
                 }
-                auto sort = &context->sort[next_length + 1];
-                auto next = &context->wait[next_length];
-                auto push_one = [&]
+                //这一层要展开哪些节点和它们的子节点无关,先选出来,再一起展开
+                auto &batch = context->batch;
+                batch.clear();
+                //被更好的置换节点顶替的不用展开
+                auto drop_transposed = [&]
                 {
-                    TetrisTreeNode *child = wait->top();
-                    wait->pop();
-                    sort->push(child);
-                    for (auto it = child->build_children<EnableHold>(); it != nullptr; it = it->children_next)
+                    while (!wait->empty() && wait->top()->is_transposed)
                     {
-                        next->push(it);
+                        wait->pop();
                     }
                 };
+                auto push_one = [&]
+                {
+                    batch.push_back(wait->top());
+                    wait->pop();
+                    drop_transposed();
+                };
+                drop_transposed();
                 if (wait->empty())
                 {
                     // do nothing
@@ -1815,7 +2707,32 @@ namespace m_tetris
                     {
                         push_one();
                     }
-                    while (sort->size() < level_prune_hold && !wait->empty());
+                    while (sort->size() + batch.size() < level_prune_hold && !wait->empty());
+                }
+                //有截止时间时分段展开,超时就把没展开的放回wait,下次再展开
+                size_t step = context->has_deadline ? std::max<size_t>(1, context->deadline_step * context->worker.size()) : batch.size();
+                for (size_t begin = 0; begin < batch.size(); begin += step)
+                {
+                    if (begin > 0 && context->is_timeout())
+                    {
+                        for (size_t i = begin; i < batch.size(); ++i)
+                        {
+                            wait->push(batch[i]);
+                        }
+                        return false;
+                    }
+                    size_t end = std::min(begin + step, batch.size());
+                    build_batch<EnableHold>(batch.data() + begin, end - begin);
+                    context->expand_count += end - begin;
+                    //按选出的顺序放入下一层,一段的子节点一起放
+                    auto &buffer = context->children_buffer;
+                    buffer.clear();
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        sort->push(batch[i]);
+                        batch[i]->push_children_(next_length, buffer);
+                    }
+                    context->wait[next_length].push(buffer.begin(), buffer.end());
                 }
             }
             if (complete)
@@ -1881,8 +2798,22 @@ namespace m_tetris
         typename ContextBuilder::LocalContext local_context_;
         TreeNode *root_;
         TetrisAI ai_;
+        //make_path/make_status/search用,和展开搜索树的分开,后台思考时也能用
         TetrisSearch search_;
+        //每个展开线程用的TetrisSearch
+        std::vector<std::unique_ptr<TetrisSearch>> worker_search_;
         typename Core::Status status_;
+        //后台思考
+        bool ponder_enable_;
+        //后台思考的节点数上限,0表示不限制
+        size_t ponder_limit_;
+        std::thread ponder_thread_;
+        //后台思考时节点可能被淘汰,run返回的status指向这里的副本
+        typename Core::Status ponder_status_;
+        //每次run最多展开的节点数,0表示只看时间
+        size_t node_budget_;
+        //超时分布,见overshoot_histogram
+        std::vector<size_t> overshoot_;
 
     public:
         typedef typename Core::Status Status;
@@ -1907,26 +2838,28 @@ namespace m_tetris
         };
 
     public:
-        TetrisEngine() : shared_context_(), ai_(), root_(new TreeNode(&local_context_)), status_()
+        TetrisEngine() : shared_context_(), ai_(), root_(local_context_.worker.front().alloc(nullptr)), status_(), ponder_enable_(), ponder_limit_(1 << 18), node_budget_(), overshoot_(20)
         {
         }
-        TetrisEngine(std::shared_ptr<TetrisContext> context) : shared_context_(context), ai_(), root_(new TreeNode(&local_context_)), status_()
+        TetrisEngine(std::shared_ptr<TetrisContext> context) : shared_context_(context), ai_(), root_(local_context_.worker.front().alloc(nullptr)), status_(), ponder_enable_(), ponder_limit_(1 << 18), node_budget_(), overshoot_(20)
         {
             local_context_.engine = shared_context_.get();
             local_context_.ai = &ai_;
-            local_context_.search = &search_;
             if (TetrisRuleInit<TetrisRule>::init(shared_context_->width(), shared_context_->height()))
             {
                 ContextBuilder::init_ai(ai_, &local_context_, shared_context_.get());
                 ContextBuilder::init_search(search_, &local_context_, shared_context_.get());
+                init_worker_search_();
             }
             else
             {
                 shared_context_.reset();
             }
         }
-        bool prepare(int width, int height)
+        //net_cache:指针网缓存目录,见TetrisContext::prepare
+        bool prepare(int width, int height, char const *net_cache = nullptr)
         {
+            stop_ponder_();
             if (shared_context_ != nullptr && shared_context_->width() == width && shared_context_->height() == height)
             {
                 return true;
@@ -1934,18 +2867,23 @@ namespace m_tetris
             shared_context_.reset(new TetrisContext());
             shared_context_->opertion_ = TetrisRule::get_opertion();
             shared_context_->generate_ = TetrisRule::get_generate();
-            if (!shared_context_->prepare(width, height))
+            if (!shared_context_->prepare(width, height, net_cache))
             {
                 shared_context_.reset();
                 return false;
             }
             local_context_.engine = shared_context_.get();
             local_context_.ai = &ai_;
-            local_context_.search = &search_;
             if (TetrisRuleInit<TetrisRule>::init(width, height))
             {
                 ContextBuilder::init_ai(ai_, &local_context_, shared_context_.get());
                 ContextBuilder::init_search(search_, &local_context_, shared_context_.get());
+                for (auto &search : worker_search_)
+                {
+                    ContextBuilder::init_search(*search, &local_context_, shared_context_.get());
+                }
+                init_worker_search_();
+                local_context_.clear_land_point_cache();
             }
             else
             {
@@ -1956,7 +2894,8 @@ namespace m_tetris
         }
         ~TetrisEngine()
         {
-            local_context_.dealloc(root_);
+            stop_ponder_();
+            local_context_.worker.front().dealloc(root_);
             local_context_.release();
         }
         //从状态获取当前块
@@ -1980,16 +2919,144 @@ namespace m_tetris
         }
         auto ai_config()->decltype(local_context_.ai_config())
         {
+            stop_ponder_();
             return local_context_.ai_config();
         }
         auto search_config() const->decltype(local_context_.search_config())
         {
             return local_context_.search_config();
         }
+        //拿可写的搜索配置时清空落点缓存,缓存的落点是按旧配置搜出来的
+        //已经展开的搜索树不会跟着变,改完配置要调update()
         auto search_config()->decltype(local_context_.search_config())
         {
+            stop_ponder_();
+            local_context_.clear_land_point_cache();
             return local_context_.search_config();
         }
+        //落点缓存,可以看命中次数,每个展开线程一个
+        TetrisLandPointCache<LandPoint> const &land_point_cache(size_t thread = 0) const
+        {
+            return local_context_.worker[thread].land_point_cache;
+        }
+        //每个展开线程的落点缓存项数,取2的幂,默认4096,0表示不缓存
+        void land_point_cache_size(size_t size)
+        {
+            stop_ponder_();
+            local_context_.land_point_cache_size = size;
+            for (auto &item : local_context_.worker)
+            {
+                item.land_point_cache.init(size);
+            }
+        }
+        size_t land_point_cache_size() const
+        {
+            return local_context_.land_point_cache_size;
+        }
+        //展开搜索树的线程数,默认1,只用调用线程
+        //每个线程有自己的TetrisSearch和节点缓存,AI的eval和get都是const的,各线程共用
+        //展开的节点和单线程完全一样,只是同一层的节点并行展开
+        void thread_count(size_t count)
+        {
+            stop_ponder_();
+            local_context_.resize_worker(count);
+            init_worker_search_();
+        }
+        size_t thread_count() const
+        {
+            return local_context_.worker.size();
+        }
+        //搜索树节点数上限,0表示不限制,超过时淘汰最差的待展开节点
+        //上限在每层展开前检查,最多超出一层展开的量
+        void node_limit(size_t limit)
+        {
+            stop_ponder_();
+            local_context_.node_limit = limit;
+        }
+        size_t node_limit() const
+        {
+            return local_context_.node_limit;
+        }
+        //按字节设置节点数上限
+        void memory_limit(size_t bytes)
+        {
+            stop_ponder_();
+            local_context_.node_limit = bytes == 0 ? 0 : std::max<size_t>(1, bytes / sizeof(TreeNode));
+        }
+        //节点预算:每次run/run_hold最多展开多少个节点,0表示不限制
+        //limit>0时时间和节点哪个先用完就停,limit<=0时只看节点数,同样的输入总是得到同样的结果
+        //预算在每轮展开之间检查,最多超出一轮展开的量
+        void node_budget(size_t budget)
+        {
+            node_budget_ = budget;
+        }
+        size_t node_budget() const
+        {
+            return node_budget_;
+        }
+        //run在展开过程中每展开step*线程数个节点看一次时间,默认16
+        void deadline_step(size_t step)
+        {
+            stop_ponder_();
+            local_context_.deadline_step = std::max<size_t>(step, 1);
+        }
+        size_t deadline_step() const
+        {
+            return local_context_.deadline_step;
+        }
+        //带时间限制的run/run_hold结束时超出时间限制的分布
+        //[0]是没超时的次数,[i]是超出[2^(i-1),2^i)微秒的次数,最后一格包括更长的
+        std::vector<size_t> const &overshoot_histogram() const
+        {
+            return overshoot_;
+        }
+        void clear_overshoot_histogram()
+        {
+            std::fill(overshoot_.begin(), overshoot_.end(), 0);
+        }
+        //延迟评价:子节点先按落点高度和消行数排进待评价的堆,不做完整评价
+        //每层每轮只完整评价要展开的节点数*ratio个,其余的一直不评价,0表示关闭(默认)
+        //打开后搜索结果和不延迟时不一样,ratio越小评价次数越少,搜得越粗
+        void lazy_eval(size_t ratio)
+        {
+            stop_ponder_();
+            local_context_.lazy_ratio = ratio;
+        }
+        size_t lazy_eval() const
+        {
+            return local_context_.lazy_ratio;
+        }
+        //合并置换节点:同一层里场景,hold,预览位置和Status里影响后续的部分都相同的节点只展开最好的一个
+        //需要AI的Status提供transposition_key(),没有的话这个开关不起作用,默认关闭
+        void transposition(bool enable)
+        {
+            stop_ponder_();
+            local_context_.transposition = enable;
+            local_context_.transposition_table.clear();
+        }
+        bool transposition() const
+        {
+            return local_context_.transposition;
+        }
+        //累计合并掉的节点数
+        size_t transposition_count() const
+        {
+            return local_context_.transposition_count;
+        }
+        //累计展开的节点数,可以用来比较不同版本的吞吐
+        size_t expand_count() const
+        {
+            return local_context_.expand_count;
+        }
+        //目前占用的节点数和累计淘汰的节点数
+        size_t node_count() const
+        {
+            return local_context_.node_count();
+        }
+        size_t evict_count() const
+        {
+            return local_context_.evict_count;
+        }
         Status const *status() const
         {
             return &status_;
@@ -2000,20 +3067,51 @@ namespace m_tetris
         }
         TetrisAI *ai()
         {
+            stop_ponder_();
             return &ai_;
         }
+        //后台思考,默认关闭
+        //打开后run/run_hold返回时起一个线程继续展开搜索树,预测的下一步的子树会接着长
+        //下次run/run_hold时停下,局面和预测的一样就沿用展开好的子树,不一样就丢掉
+        //改ai/配置/线程数/节点上限等会先停下后台思考;make_path/make_status/search可以同时用
+        //后台思考展开的是整棵树,节点数到了ponder_limit就停下,不会在空闲时一直长
+        //node_count/expand_count这些统计要在后台思考停下后再看,ponder(false)会停下
+        void ponder(bool enable)
+        {
+            stop_ponder_();
+            ponder_enable_ = enable;
+        }
+        bool ponder() const
+        {
+            return ponder_enable_;
+        }
+        //后台思考的节点数上限,默认1<<18,0表示一直长到搜索完(这时最好和node_limit/memory_limit一起用)
+        void ponder_limit(size_t limit)
+        {
+            stop_ponder_();
+            ponder_limit_ = limit;
+        }
+        size_t ponder_limit() const
+        {
+            return ponder_limit_;
+        }
         //update!强制刷新上下文
         void update()
         {
+            stop_ponder_();
             local_context_.is_complete = false;
             ++local_context_.version;
             local_context_.total += local_context_.width;
             local_context_.avg = local_context_.total / local_context_.version;
             local_context_.width = 0;
+            local_context_.clear_land_point_cache();
             local_context_.wait.clear();
             local_context_.sort.clear();
+            local_context_.pending.clear();
+            local_context_.transposition_table.clear();
             local_context_.wait.resize(local_context_.max_length + 1);
             local_context_.sort.resize(local_context_.max_length + 1);
+            local_context_.pending.resize(local_context_.max_length + 1);
         }
         //run!
         RunResult run(TetrisMap const &map, TetrisNode const *node, char const *next, size_t next_length, time_t limit = 100)
@@ -2023,16 +3121,13 @@ namespace m_tetris
             {
                 return RunResult();
             }
-            auto now = high_resolution_clock::now(), end = now + std::chrono::milliseconds(limit);
+            stop_ponder_();
+            auto end = high_resolution_clock::now() + std::chrono::milliseconds(limit);
             root_ = root_->update(map, status_, node, next, next_length);
-            do
-            {
-                if (root_->template run<false>())
-                {
-                    break;
-                }
-            } while ((now = high_resolution_clock::now()) < end);
-            return RunResult(root_->get_best());
+            run_until_<false>(end, limit);
+            RunResult result(root_->get_best());
+            start_ponder_<false>(result);
+            return result;
         }
         //带hold的run!
         RunResult run_hold(TetrisMap const &map, TetrisNode const *node, char hold, bool hold_free, char const *next, size_t next_length, time_t limit = 100)
@@ -2042,15 +3137,10 @@ namespace m_tetris
             {
                 return RunResult();
             }
-            auto now = high_resolution_clock::now(), end = now + std::chrono::milliseconds(limit);
+            stop_ponder_();
+            auto end = high_resolution_clock::now() + std::chrono::milliseconds(limit);
             root_ = root_->update(map, status_, node, hold, !hold_free, next, next_length);
-            do
-            {
-                if (root_->template run<true>())
-                {
-                    break;
-                }
-            } while ((now = high_resolution_clock::now()) < end);
+            run_until_<true>(end, limit);
             if (root_->hold == ' ' && local_context_.next.size() == 1 && !root_->is_hold_lock)
             {
                 return RunResult(true);
@@ -2058,7 +3148,9 @@ namespace m_tetris
             else
             {
                 auto best = root_->get_best();
-                return RunResult(best, best.first == nullptr ? false : best.first->is_hold);
+                RunResult result(best, best.first == nullptr ? false : best.first->is_hold);
+                start_ponder_<true>(result);
+                return result;
             }
         }
         //根据run的结果得到一个操作路径
@@ -2086,11 +3178,98 @@ namespace m_tetris
             auto const *land_point = search_.search(map, node);
             result.assign(land_point->begin(), land_point->end());
         }
+
+    private:
+        //给每个展开线程配好TetrisSearch,新建的按当前上下文初始化
+        void init_worker_search_()
+        {
+            size_t count = local_context_.worker.size();
+            worker_search_.resize(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto &search = worker_search_[i];
+                if (search == nullptr)
+                {
+                    search.reset(new TetrisSearch());
+                    if (shared_context_ != nullptr)
+                    {
+                        ContextBuilder::init_search(*search, &local_context_, shared_context_.get());
+                    }
+                }
+                local_context_.worker[i].search = search.get();
+            }
+        }
+        //展开到搜索完,或者用完时间/节点预算
+        template<bool EnableHold>
+        void run_until_(std::chrono::high_resolution_clock::time_point end, time_t limit)
+        {
+            using namespace std::chrono;
+            size_t expand_end = local_context_.expand_count + node_budget_;
+            bool check_time = node_budget_ == 0 || limit > 0;
+            local_context_.deadline = end;
+            local_context_.has_deadline = limit > 0;
+            do
+            {
+                if (root_->template run<EnableHold>())
+                {
+                    break;
+                }
+            } while ((node_budget_ == 0 || local_context_.expand_count < expand_end) && (!check_time || high_resolution_clock::now() < end));
+            local_context_.has_deadline = false;
+            if (limit > 0)
+            {
+                auto over = duration_cast<microseconds>(high_resolution_clock::now() - end).count();
+                size_t index = 0;
+                while (over > 0 && index + 1 < overshoot_.size())
+                {
+                    over >>= 1;
+                    ++index;
+                }
+                ++overshoot_[index];
+            }
+        }
+        template<bool EnableHold>
+        void start_ponder_(RunResult &result)
+        {
+            if (!ponder_enable_ || local_context_.is_complete)
+            {
+                return;
+            }
+            if (result.status != nullptr)
+            {
+                ponder_status_ = *result.status;
+                result.status = &ponder_status_;
+            }
+            local_context_.stop = false;
+            size_t limit = ponder_limit_;
+            ponder_thread_ = std::thread([this, limit]
+            {
+                while (!local_context_.stop.load(std::memory_order_relaxed) && (limit == 0 || local_context_.node_count() < limit) && !root_->template run<EnableHold>())
+                {
+                }
+            });
+        }
+        void stop_ponder_()
+        {
+            if (ponder_thread_.joinable())
+            {
+                local_context_.stop = true;
+                ponder_thread_.join();
+                local_context_.stop = false;
+            }
+        }
     };
 
 
     inline bool TetrisNode::check(TetrisMap const &map) const
     {
+#if __SSE4_2__
+        //一次比较4行,data中超出height的行都是0
+        //row靠近顶部时多读的几行落在TetrisMap::top里,不会越界,也不影响结果
+        __m128i map_row = _mm_loadu_si128(reinterpret_cast<__m128i const *>(map.row + row));
+        __m128i node_row = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data));
+        return _mm_testz_si128(map_row, node_row) != 0;
+#else
         switch (height)
         {
         default:
@@ -2104,6 +3283,33 @@ namespace m_tetris
         case 1:
             return ((map.row[row] & data[0])) == 0;
         }
+#endif
+    }
+
+    inline uint32_t TetrisNodeList::check(TetrisMap const &map) const
+    {
+        assert(length_ <= 32);
+        TetrisNodeLink const *link = data();
+        uint32_t result = 0;
+        for (uint32_t i = 0; i < length_; ++i)
+        {
+            result |= uint32_t(link[i]->check(map)) << i;
+        }
+        return result;
+    }
+
+    inline TetrisNode const *TetrisNodeList::check_first(TetrisMap const &map) const
+    {
+        TetrisNodeLink const *link = data();
+        for (uint32_t i = 0; i < length_; ++i)
+        {
+            TetrisNode const *node = link[i].get();
+            if (node->check(map))
+            {
+                return node;
+            }
+        }
+        return nullptr;
     }
 
     inline bool TetrisNode::check(TetrisMapSnap const &snap) const
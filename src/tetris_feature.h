@@ -0,0 +1,86 @@
+﻿#pragma once
+
+#include "tetris_core.h"
+#include "integer_utils.h"
+
+namespace m_tetris
+{
+    //各个AI的eval共用的场景特征
+    class TetrisFeature
+    {
+    public:
+        struct Trans
+        {
+            //列变换,左右墙算满,roof以上的空行每行算2
+            int col;
+            //行变换,地板算满,roof以上算空
+            int row;
+        };
+        //宽度不超过这个的时候一行的列变换直接查表
+        static int const table_width = 12;
+        void init(TetrisContext const *context)
+        {
+            col_mask_ = context->full() & ~1;
+            row_mask_ = context->full();
+            width_m1_ = context->width() - 1;
+            col_trans_table_.clear();
+            if (context->width() <= table_width)
+            {
+                col_trans_table_.resize(size_t(1) << context->width());
+                for (uint32_t row = 0; row < col_trans_table_.size(); ++row)
+                {
+                    col_trans_table_[row] = uint8_t(col_trans_calc_(row));
+                }
+            }
+        }
+        uint32_t col_mask() const
+        {
+            return col_mask_;
+        }
+        uint32_t row_mask() const
+        {
+            return row_mask_;
+        }
+        //一行的列变换
+        int col_trans(uint32_t row) const
+        {
+            return col_trans_table_.empty() ? col_trans_calc_(row) : col_trans_table_[row & row_mask_];
+        }
+        //顶满的时候最上面一行不算
+        Trans trans(TetrisMap const &map) const
+        {
+            int const roof = map.roof;
+            Trans trans = { 2 * (map.height - roof), int(ZZZ_BitCount(row_mask_ & ~map.row[0])) };
+            if (roof == 0)
+            {
+                return trans;
+            }
+            trans.col += col_trans(map.row[0]);
+            for (int y = 1; y < roof; ++y)
+            {
+                trans.col += col_trans(map.row[y]);
+                trans.row += int(ZZZ_BitCount(map.row[y - 1] ^ map.row[y]));
+            }
+            if (roof != map.height)
+            {
+                trans.row += int(ZZZ_BitCount(map.row[roof - 1]));
+            }
+            return trans;
+        }
+        //行变换把左右墙也算上,顶满的时候上面算满
+        Trans trans_wall(TetrisMap const &map) const
+        {
+            Trans trans = this->trans(map);
+            trans.row += map.roof == map.height ? int(ZZZ_BitCount(row_mask_ & ~map.row[map.roof - 1])) : map.width;
+            return trans;
+        }
+    private:
+        int col_trans_calc_(uint32_t row) const
+        {
+            return !(row & 1) + !((row >> width_m1_) & 1) + int(ZZZ_BitCount((row ^ (row << 1)) & col_mask_));
+        }
+        uint32_t col_mask_, row_mask_;
+        int width_m1_;
+        std::vector<uint8_t> col_trans_table_;
+    };
+}
@@ -0,0 +1,773 @@
+﻿
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <random>
+
+#include "tetris_core.h"
+
+namespace m_tetris
+{
+    //蒙特卡洛树搜索(UCT),和TetrisEngine用同样的TetrisRule,TetrisAI,TetrisSearch,接口也一样,可以直接换掉
+    //选择:没试过的子节点按评价从高到低先试,都试过之后按UCT选
+    //模拟:新节点每步放评价最高的落点(不用hold),放完预览或者rollout_depth步,最后的Status::key()就是这次模拟的分
+    //预览里的'?'每次走到时随机抽一种方块,每种方块各自一组子节点
+    //多线程时所有线程在同一棵树上模拟,走过的节点加虚拟损失,让其它线程先走别的路
+    //每次run都重新建树,Status要有key()或者本身是数值
+    template<class TetrisRule, class TetrisAI, class TetrisSearch>
+    class TetrisMCTSEngine
+    {
+    private:
+        typedef TetrisCore<TetrisAI, TetrisSearch> Core;
+        typedef typename Core::LandPoint LandPoint;
+    public:
+        typedef typename Core::Status Status;
+    private:
+        static_assert(std::is_arithmetic<typename TetrisStatusKey<Status>::type>::value, "TetrisMCTSEngine need Status::key()");
+        struct Context;
+        struct TreeNode;
+        //一个方块的所有落点,子节点按评价从高到低排好
+        struct Branch
+        {
+            Branch(char _piece) : state(0), piece(_piece), count(), tried(0), child()
+            {
+            }
+            //0没展开,1正在展开,2展开好了
+            std::atomic<uint8_t> state;
+            char piece;
+            uint32_t count;
+            //按顺序试过的子节点数
+            std::atomic<uint32_t> tried;
+            TreeNode **child;
+        };
+        struct NodeStatus
+        {
+            Status status;
+            Status const &get() const
+            {
+                return status;
+            }
+            Status const &get_raw() const
+            {
+                return status;
+            }
+            void set(Status const &_status)
+            {
+                status = _status;
+            }
+        };
+        struct TreeNode
+        {
+            TreeNode(Context *_context, TreeNode *_parent) : map(0, 0), identity(), result(), status(), context(_context), parent(_parent), branch(), branch_count(), pos(), hold(' '), level(), is_hold(), is_hold_lock(), visit(0), virtual_loss(0), value(0)
+            {
+            }
+            TetrisMap map;
+            LandPoint identity;
+            typename Core::Result result;
+            NodeStatus status;
+            Context *context;
+            TreeNode *parent;
+            //方块已知时一个,'?'时每种方块一个,预览用完时没有
+            Branch *branch;
+            uint32_t branch_count;
+            //下一个要放的方块在context->next里的位置
+            uint32_t pos;
+            char hold;
+            uint8_t level;
+            bool is_hold;
+            bool is_hold_lock;
+            std::atomic<uint32_t> visit;
+            std::atomic<uint32_t> virtual_loss;
+            //模拟分的累计
+            std::atomic<double> value;
+
+            template<bool EnableEnv>
+            TetrisContext::Env env(TreeNode const *child) const
+            {
+                TetrisContext::Env result =
+                {
+                    nullptr, 0, ' ', ' ', false
+                };
+                if (EnableEnv)
+                {
+                    size_t begin = std::min<size_t>(pos + 1, context->next.size());
+                    result.length = context->next.size() - begin;
+                    result.next = result.length == 0 ? nullptr : context->next.data() + begin;
+                    result.node = child->identity->status.t;
+                    result.hold = child->hold;
+                    result.is_hold = child->is_hold;
+                }
+                return result;
+            }
+        };
+        struct Context
+        {
+            //每个线程独占的数据,worker[0]给调用线程用
+            struct Worker
+            {
+                Worker(Context *context) : block(), offset(), expand_count(), simulation_count(), scratch{ { context, nullptr }, { context, nullptr }, { context, nullptr } }
+                {
+                    land_point_cache.init(4096);
+                }
+                TetrisSearch search;
+                TetrisLandPointCache<LandPoint> land_point_cache;
+                //节点和子节点表都从slab里按顺序切,重新建树时从头再切,不释放
+                TetrisNodeSlab slab;
+                size_t block;
+                size_t offset;
+                std::vector<TreeNode *> node;
+                std::vector<TreeNode *> path;
+                std::vector<TreeNode *> children;
+                std::mt19937 random;
+                size_t expand_count;
+                size_t simulation_count;
+                //模拟时轮换用的节点
+                TreeNode scratch[3];
+
+                std::vector<LandPoint> const *land_point(TetrisMap const &map, TetrisNode const *node, size_t level)
+                {
+                    return land_point_cache.search(search, map, node, level);
+                }
+                void *alloc(size_t size)
+                {
+                    size_t align = alignof(std::max_align_t);
+                    size = (size + align - 1) / align * align;
+                    while (block < slab.block_count() && offset + size > slab.block_size(block))
+                    {
+                        ++block;
+                        offset = 0;
+                    }
+                    if (block == slab.block_count())
+                    {
+                        size_t count;
+                        slab.grow(1, count);
+                    }
+                    assert(offset + size <= slab.block_size(block));
+                    void *data = slab.block(block) + offset;
+                    offset += size;
+                    return data;
+                }
+                TreeNode *alloc_node(TreeNode *parent)
+                {
+                    TreeNode *tree_node = new (alloc(sizeof(TreeNode))) TreeNode(parent->context, parent);
+                    node.push_back(tree_node);
+                    return tree_node;
+                }
+                void reset()
+                {
+                    for (auto tree_node : node)
+                    {
+                        tree_node->~TreeNode();
+                    }
+                    node.clear();
+                    block = 0;
+                    offset = 0;
+                }
+            };
+            Context() : engine(), ai(), exploration(0.7), rollout_depth(std::numeric_limits<size_t>::max()), value_min(0), value_max(0)
+            {
+            }
+            TetrisContext const *engine;
+            TetrisAI *ai;
+            std::vector<std::unique_ptr<Worker>> worker;
+            TetrisWorkerPool pool;
+            //当前块和预览,'?'原样留着
+            std::vector<char> next;
+            double exploration;
+            size_t rollout_depth;
+            //模拟分的范围,UCT按这个归一化
+            std::atomic<double> value_min;
+            std::atomic<double> value_max;
+        };
+        typedef typename Context::Worker Worker;
+        typedef LocalContextBuilder<Context, TetrisRule, TetrisAI, TetrisSearch> ContextBuilder;
+
+        std::shared_ptr<TetrisContext> shared_context_;
+        typename ContextBuilder::LocalContext local_context_;
+        TetrisAI ai_;
+        //make_path/make_status/search用
+        TetrisSearch search_;
+        TreeNode *root_;
+        Status status_;
+        //每次run最多模拟多少次,0表示只看时间
+        size_t simulation_budget_;
+        uint32_t seed_;
+        std::atomic<size_t> simulation_;
+
+    public:
+        struct RunResult
+        {
+            RunResult() : target(), status(), change_hold()
+            {
+            }
+            RunResult(bool _change_hold) : target(), status(), change_hold(_change_hold)
+            {
+            }
+            RunResult(TreeNode const *_node, Status const *_status) : target(_node->identity), status(_status), change_hold(_node->is_hold)
+            {
+            }
+            LandPoint target;
+            Status const *status;
+            bool change_hold;
+        };
+
+    public:
+        TetrisMCTSEngine() : shared_context_(), ai_(), root_(), status_(), simulation_budget_(), seed_(), simulation_(0)
+        {
+            thread_count(1);
+        }
+        //net_cache:指针网缓存目录,见TetrisContext::prepare
+        bool prepare(int width, int height, char const *net_cache = nullptr)
+        {
+            if (shared_context_ != nullptr && shared_context_->width() == width && shared_context_->height() == height)
+            {
+                return true;
+            }
+            shared_context_.reset(new TetrisContext());
+            shared_context_->opertion_ = TetrisRule::get_opertion();
+            shared_context_->generate_ = TetrisRule::get_generate();
+            if (!shared_context_->prepare(width, height, net_cache))
+            {
+                shared_context_.reset();
+                return false;
+            }
+            local_context_.engine = shared_context_.get();
+            local_context_.ai = &ai_;
+            if (TetrisRuleInit<TetrisRule>::init(width, height))
+            {
+                ContextBuilder::init_ai(ai_, &local_context_, shared_context_.get());
+                ContextBuilder::init_search(search_, &local_context_, shared_context_.get());
+                for (auto &worker : local_context_.worker)
+                {
+                    ContextBuilder::init_search(worker->search, &local_context_, shared_context_.get());
+                    worker->land_point_cache.clear();
+                }
+            }
+            else
+            {
+                shared_context_.reset();
+                return false;
+            }
+            return true;
+        }
+        ~TetrisMCTSEngine()
+        {
+            for (auto &worker : local_context_.worker)
+            {
+                worker->reset();
+            }
+        }
+        //从状态获取当前块
+        TetrisNode const *get(TetrisBlockStatus const &status) const
+        {
+            return shared_context_->get(status);
+        }
+        //上下文对象...
+        std::shared_ptr<TetrisContext> context() const
+        {
+            return shared_context_;
+        }
+        //AI名称
+        std::string ai_name() const
+        {
+            return ai_.ai_name();
+        }
+        auto ai_config() const->decltype(local_context_.ai_config())
+        {
+            return local_context_.ai_config();
+        }
+        auto ai_config()->decltype(local_context_.ai_config())
+        {
+            return local_context_.ai_config();
+        }
+        auto search_config() const->decltype(local_context_.search_config())
+        {
+            return local_context_.search_config();
+        }
+        auto search_config()->decltype(local_context_.search_config())
+        {
+            return local_context_.search_config();
+        }
+        //模拟的线程数,默认1,只用调用线程
+        void thread_count(size_t count)
+        {
+            count = std::max<size_t>(count, 1);
+            auto &worker = local_context_.worker;
+            for (size_t i = count; i < worker.size(); ++i)
+            {
+                worker[i]->reset();
+            }
+            size_t old_count = worker.size();
+            worker.resize(count);
+            for (size_t i = old_count; i < count; ++i)
+            {
+                worker[i].reset(new Worker(&local_context_));
+                if (shared_context_ != nullptr)
+                {
+                    ContextBuilder::init_search(worker[i]->search, &local_context_, shared_context_.get());
+                }
+            }
+            local_context_.pool.resize(count);
+            root_ = nullptr;
+        }
+        size_t thread_count() const
+        {
+            return local_context_.worker.size();
+        }
+        //每次run/run_hold最多模拟多少次,0表示不限制
+        //limit>0时时间和次数哪个先用完就停,limit<=0时只看次数,单线程时同样的输入总是得到同样的结果
+        //limit<=0又没有预算时每个第一步各模拟一次
+        void simulation_budget(size_t budget)
+        {
+            simulation_budget_ = budget;
+        }
+        size_t simulation_budget() const
+        {
+            return simulation_budget_;
+        }
+        //UCT的探索系数,分数归一化到[0,1]之后用,默认0.7
+        void exploration(double c)
+        {
+            local_context_.exploration = c;
+        }
+        double exploration() const
+        {
+            return local_context_.exploration;
+        }
+        //模拟往下放几步,默认放完预览,0表示直接用新节点的评价
+        void rollout_depth(size_t depth)
+        {
+            local_context_.rollout_depth = depth;
+        }
+        size_t rollout_depth() const
+        {
+            return local_context_.rollout_depth;
+        }
+        //'?'抽方块用的随机数种子,每次run重新播种
+        void seed(uint32_t value)
+        {
+            seed_ = value;
+        }
+        uint32_t seed() const
+        {
+            return seed_;
+        }
+        //累计模拟次数
+        size_t simulation_count() const
+        {
+            size_t count = 0;
+            for (auto &worker : local_context_.worker)
+            {
+                count += worker->simulation_count;
+            }
+            return count;
+        }
+        //累计展开的节点数,和TetrisEngine::expand_count一样算
+        size_t expand_count() const
+        {
+            size_t count = 0;
+            for (auto &worker : local_context_.worker)
+            {
+                count += worker->expand_count;
+            }
+            return count;
+        }
+        //上次run建的树的节点数
+        size_t node_count() const
+        {
+            size_t count = 0;
+            for (auto &worker : local_context_.worker)
+            {
+                count += worker->node.size();
+            }
+            return count;
+        }
+        Status const *status() const
+        {
+            return &status_;
+        }
+        Status *status()
+        {
+            return &status_;
+        }
+        TetrisAI *ai()
+        {
+            return &ai_;
+        }
+        //update!改了搜索配置之后调用,清掉落点缓存
+        void update()
+        {
+            for (auto &worker : local_context_.worker)
+            {
+                worker->land_point_cache.clear();
+            }
+        }
+        //run!
+        RunResult run(TetrisMap const &map, TetrisNode const *node, char const *next, size_t next_length, time_t limit = 100)
+        {
+            if (shared_context_ == nullptr || node == nullptr || !node->check(map))
+            {
+                return RunResult();
+            }
+            return run_<false>(map, node, ' ', true, next, next_length, limit);
+        }
+        //带hold的run!
+        RunResult run_hold(TetrisMap const &map, TetrisNode const *node, char hold, bool hold_free, char const *next, size_t next_length, time_t limit = 100)
+        {
+            if (shared_context_ == nullptr || node == nullptr || !node->check(map))
+            {
+                return RunResult();
+            }
+            if (hold == ' ' && next_length == 0 && hold_free)
+            {
+                return RunResult(true);
+            }
+            return run_<true>(map, node, hold, !hold_free, next, next_length, limit);
+        }
+        //根据run的结果得到一个操作路径
+        std::vector<char> make_path(TetrisNode const *node, LandPoint const &land_point, TetrisMap const &map, bool cut_drop = true)
+        {
+            auto path = search_.make_path(node, land_point, map);
+            if (cut_drop)
+            {
+                while (!path.empty() && (path.back() == 'd' || path.back() == 'D'))
+                {
+                    path.pop_back();
+                }
+            }
+            return path;
+        }
+        //根据run的结果得到一组按键状态
+        std::vector<char> make_status(TetrisNode const *node, LandPoint const &land_point, TetrisMap const &map)
+        {
+            return search_.make_status(node, land_point, map);
+        }
+        //单块评价
+        template<class container_t>
+        void search(TetrisNode const *node, TetrisMap const &map, container_t &result)
+        {
+            auto const *land_point = search_.search(map, node);
+            result.assign(land_point->begin(), land_point->end());
+        }
+
+    private:
+        static double key_(TreeNode const *node)
+        {
+            return double(TetrisStatusKey<Status>::get(node->status.get()));
+        }
+        static void add_(std::atomic<double> &target, double value)
+        {
+            double old = target.load(std::memory_order_relaxed);
+            while (!target.compare_exchange_weak(old, old + value, std::memory_order_relaxed))
+            {
+            }
+        }
+        void update_bound_(double value)
+        {
+            auto &value_min = local_context_.value_min, &value_max = local_context_.value_max;
+            double old = value_min.load(std::memory_order_relaxed);
+            while (value < old && !value_min.compare_exchange_weak(old, value, std::memory_order_relaxed))
+            {
+            }
+            old = value_max.load(std::memory_order_relaxed);
+            while (value > old && !value_max.compare_exchange_weak(old, value, std::memory_order_relaxed))
+            {
+            }
+        }
+        template<bool EnableHold>
+        RunResult run_(TetrisMap const &map, TetrisNode const *node, char hold, bool hold_lock, char const *next, size_t next_length, time_t limit)
+        {
+            using namespace std::chrono;
+            auto end = high_resolution_clock::now() + milliseconds(limit);
+            auto &context = local_context_;
+            context.next.assign(1, node->status.t);
+            context.next.insert(context.next.end(), next, next + next_length);
+            context.value_min = std::numeric_limits<double>::infinity();
+            context.value_max = -std::numeric_limits<double>::infinity();
+            for (size_t i = 0; i < context.worker.size(); ++i)
+            {
+                context.worker[i]->reset();
+                context.worker[i]->random.seed(seed_ + uint32_t(i));
+            }
+            Worker &main = *context.worker.front();
+            root_ = new (main.alloc(sizeof(TreeNode))) TreeNode(&context, nullptr);
+            main.node.push_back(root_);
+            root_->map = map;
+            root_->status.set(status_);
+            root_->hold = EnableHold ? hold : ' ';
+            root_->is_hold_lock = hold_lock;
+            init_branch_<EnableHold>(main, root_);
+            //先模拟一次,保证有结果,也把第一层展开
+            simulate_<EnableHold>(main);
+            size_t budget = simulation_budget_;
+            if (limit <= 0 && budget == 0)
+            {
+                budget = root_->branch[0].count;
+            }
+            simulation_ = 1;
+            context.pool.run(context.worker.size(), [this, &context, end, limit, budget](size_t, size_t thread)
+            {
+                Worker &worker = *context.worker[thread];
+                while (true)
+                {
+                    size_t count = simulation_.fetch_add(1, std::memory_order_relaxed);
+                    if ((budget != 0 && count >= budget) || (limit > 0 && high_resolution_clock::now() >= end))
+                    {
+                        break;
+                    }
+                    simulate_<EnableHold>(worker);
+                }
+            });
+            return get_best_();
+        }
+        //看下一个要放的方块,决定有几组子节点
+        template<bool EnableHold>
+        void init_branch_(Worker &worker, TreeNode *node)
+        {
+            auto &next = local_context_.next;
+            if (node->pos < next.size() && next[node->pos] == '?')
+            {
+                size_t max = local_context_.engine->type_max();
+                node->branch = static_cast<Branch *>(worker.alloc(sizeof(Branch) * max));
+                for (size_t i = 0; i < max; ++i)
+                {
+                    new (node->branch + i) Branch(local_context_.engine->convert(i));
+                }
+                node->branch_count = uint32_t(max);
+            }
+            else if (node->pos < next.size() || (EnableHold && node->hold != ' '))
+            {
+                node->branch = new (worker.alloc(sizeof(Branch))) Branch(node->pos < next.size() ? next[node->pos] : ' ');
+                node->branch_count = 1;
+            }
+        }
+        template<bool EnableHold>
+        void add_children_(Worker &worker, TreeNode *node, char piece, char type, bool is_hold)
+        {
+            uint32_t size = uint32_t(local_context_.next.size());
+            for (auto land_point : *worker.land_point(node->map, local_context_.engine->generate(type), node->level))
+            {
+                TreeNode *child = worker.alloc_node(node);
+                Core::eval(*local_context_.ai, node->map, land_point, child);
+                child->is_hold = is_hold;
+                child->hold = EnableHold ? (is_hold ? piece : node->hold) : ' ';
+                child->pos = std::min(is_hold && node->hold == ' ' ? node->pos + 2 : node->pos + 1, size);
+                child->level = node->level + 1;
+                Core::template get<true>(*local_context_.ai, child, node);
+                init_branch_<EnableHold>(worker, child);
+                worker.children.push_back(child);
+            }
+        }
+        //hold的规则和TetrisTreeNode::search_children一样,hold空着又要拿'?'换时不用hold
+        template<bool EnableHold>
+        void expand_(Worker &worker, TreeNode *node, Branch &branch)
+        {
+            auto &next = local_context_.next;
+            auto &children = worker.children;
+            children.clear();
+            char piece = branch.piece;
+            if (piece != ' ')
+            {
+                add_children_<EnableHold>(worker, node, piece, piece, false);
+            }
+            if (EnableHold && !node->is_hold_lock)
+            {
+                if (node->hold != ' ')
+                {
+                    add_children_<EnableHold>(worker, node, piece, node->hold, true);
+                }
+                else if (piece != ' ' && node->pos + 1 < next.size() && next[node->pos + 1] != '?')
+                {
+                    add_children_<EnableHold>(worker, node, piece, next[node->pos + 1], true);
+                }
+            }
+            std::sort(children.begin(), children.end(), [](TreeNode const *left, TreeNode const *right)
+            {
+                return right->status.get() < left->status.get();
+            });
+            branch.child = static_cast<TreeNode **>(worker.alloc(sizeof(TreeNode *) * std::max<size_t>(children.size(), 1)));
+            std::copy(children.begin(), children.end(), branch.child);
+            branch.count = uint32_t(children.size());
+            ++worker.expand_count;
+            branch.state.store(2, std::memory_order_release);
+        }
+        //UCT,没回来的模拟当作输了一次
+        TreeNode *select_(Branch &branch)
+        {
+            double low = local_context_.value_min.load(std::memory_order_relaxed);
+            double high = local_context_.value_max.load(std::memory_order_relaxed);
+            double scale = high > low ? 1 / (high - low) : 0;
+            double total = 0;
+            for (uint32_t i = 0; i < branch.count; ++i)
+            {
+                TreeNode *child = branch.child[i];
+                total += child->visit.load(std::memory_order_relaxed) + child->virtual_loss.load(std::memory_order_relaxed);
+            }
+            double log_total = std::log(std::max(total, 1.0));
+            TreeNode *best = nullptr;
+            double best_score = -std::numeric_limits<double>::infinity();
+            for (uint32_t i = 0; i < branch.count; ++i)
+            {
+                TreeNode *child = branch.child[i];
+                uint32_t visit = child->visit.load(std::memory_order_relaxed);
+                uint32_t count = visit + child->virtual_loss.load(std::memory_order_relaxed);
+                if (count == 0)
+                {
+                    return child;
+                }
+                double q = scale == 0 ? 0.5 * visit / count : (child->value.load(std::memory_order_relaxed) - low * visit) * scale / count;
+                double score = q + local_context_.exploration * std::sqrt(log_total / count);
+                if (score > best_score)
+                {
+                    best_score = score;
+                    best = child;
+                }
+            }
+            return best;
+        }
+        //从节点开始每步放评价最高的落点,返回最后的分,死了返回目前最低的分
+        double rollout_(Worker &worker, TreeNode const *node)
+        {
+            auto &context = local_context_;
+            TreeNode *current = &worker.scratch[0], *best, *candidate = &worker.scratch[1], *spare = &worker.scratch[2];
+            current->map = node->map;
+            current->status.set(node->status.get());
+            current->pos = node->pos;
+            current->hold = node->hold;
+            current->level = node->level;
+            for (size_t depth = 0; depth < context.rollout_depth && current->pos < context.next.size(); ++depth)
+            {
+                char piece = context.next[current->pos];
+                if (piece == '?')
+                {
+                    piece = context.engine->convert(size_t(worker.random() % context.engine->type_max()));
+                }
+                best = nullptr;
+                for (auto land_point : *worker.land_point(current->map, context.engine->generate(piece), current->level))
+                {
+                    Core::eval(*context.ai, current->map, land_point, candidate);
+                    candidate->is_hold = false;
+                    candidate->hold = current->hold;
+                    candidate->pos = current->pos + 1;
+                    candidate->level = current->level + 1;
+                    Core::template get<true>(*context.ai, candidate, current);
+                    if (best == nullptr)
+                    {
+                        best = candidate;
+                        candidate = spare;
+                    }
+                    else if (best->status.get() < candidate->status.get())
+                    {
+                        std::swap(best, candidate);
+                    }
+                }
+                if (best == nullptr)
+                {
+                    return std::min(key_(current), context.value_min.load(std::memory_order_relaxed));
+                }
+                spare = current;
+                current = best;
+            }
+            return key_(current);
+        }
+        template<bool EnableHold>
+        void simulate_(Worker &worker)
+        {
+            auto &path = worker.path;
+            path.clear();
+            TreeNode *node = root_;
+            path.push_back(node);
+            double value;
+            while (true)
+            {
+                if (node->branch_count == 0)
+                {
+                    value = key_(node);
+                    break;
+                }
+                Branch &branch = node->branch[node->branch_count == 1 ? 0 : worker.random() % node->branch_count];
+                if (branch.state.load(std::memory_order_acquire) != 2)
+                {
+                    uint8_t expect = 0;
+                    if (branch.state.compare_exchange_strong(expect, 1, std::memory_order_acq_rel))
+                    {
+                        expand_<EnableHold>(worker, node, branch);
+                    }
+                    else
+                    {
+                        while (branch.state.load(std::memory_order_acquire) != 2)
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                }
+                if (branch.count == 0)
+                {
+                    value = std::min(key_(node), local_context_.value_min.load(std::memory_order_relaxed));
+                    break;
+                }
+                if (branch.tried.load(std::memory_order_relaxed) < branch.count)
+                {
+                    uint32_t tried = branch.tried.fetch_add(1, std::memory_order_relaxed);
+                    if (tried < branch.count)
+                    {
+                        node = branch.child[tried];
+                        node->virtual_loss.fetch_add(1, std::memory_order_relaxed);
+                        path.push_back(node);
+                        value = rollout_(worker, node);
+                        break;
+                    }
+                }
+                node = select_(branch);
+                node->virtual_loss.fetch_add(1, std::memory_order_relaxed);
+                path.push_back(node);
+            }
+            ++worker.simulation_count;
+            update_bound_(value);
+            for (auto it : path)
+            {
+                add_(it->value, value);
+                it->visit.fetch_add(1, std::memory_order_relaxed);
+                if (it != root_)
+                {
+                    it->virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+        }
+        static TreeNode *most_visit_(Branch const &branch)
+        {
+            TreeNode *best = nullptr;
+            for (uint32_t i = 0; i < branch.count; ++i)
+            {
+                TreeNode *child = branch.child[i];
+                if (best == nullptr || child->visit > best->visit || (child->visit == best->visit && child->visit != 0 && child->value / child->visit > best->value / best->visit))
+                {
+                    best = child;
+                }
+            }
+            return best;
+        }
+        //第一步选模拟次数最多的,Status沿着模拟最多的路走到头,遇到'?'就停
+        RunResult get_best_()
+        {
+            if (root_->branch_count == 0 || root_->branch[0].state != 2 || root_->branch[0].count == 0)
+            {
+                return RunResult();
+            }
+            TreeNode *best = most_visit_(root_->branch[0]);
+            TreeNode *leaf = best;
+            while (leaf->branch_count == 1 && leaf->branch[0].state == 2 && leaf->branch[0].count != 0)
+            {
+                TreeNode *child = most_visit_(leaf->branch[0]);
+                if (child->visit == 0)
+                {
+                    break;
+                }
+                leaf = child;
+            }
+            return RunResult(best, &leaf->status.get_raw());
+        }
+    };
+}
@@ -224,6 +224,8 @@ std::map<std::string, std::function<bool(std::vector<std::string> const &)>> com
                     }
                 }
             }
+            map1.rehash();
+            map2.rehash();
             char next_arr[] = {next_piece, '?'};
             std::vector<char> ai_path;
             ai_tag::the_ai_games::TetrisNodeEx target;
@@ -512,6 +514,7 @@ struct test_ai
                 }
             }
         }
+        map.rehash();
     }
 };
 
@@ -81,6 +81,7 @@ struct tetris_game
                 }
             }
         }
+        map.rehash();
     }
 
     bool init(size_t w, size_t h, size_t next, std::wstring dll)
@@ -214,6 +215,7 @@ struct tetris_game
         map.height = tetris_ai.context()->height();
         map.count = 0;
         map.roof = 0;
+        map.hash = 0;
         std::memset(map.top, 0, sizeof map.top);
         std::memset(map.row, 0, sizeof map.row);
         next.clear();
@@ -412,6 +414,7 @@ int speed_test(unsigned int argc, wchar_t *argv[], wchar_t *eve[])
             this_lines = 0;
             map.count = 0;
             map.roof = 0;
+            map.hash = 0;
             std::memset(map.top, 0, sizeof map.top);
             std::memset(map.row, 0, sizeof map.row);
         }